@@ -1,161 +1,438 @@
+#include <atomic>
+#include <chrono>
 #include <map>
+#include <memory>
+#include <random>
+#include <thread>
 
 #include "intcode.hpp"
+#include "prelude.hpp"
 
-enum class Color { White, Black };
-enum class Direction { Up, Down, Left, Right };
+// values match the color codes the painting program reads and writes
+enum class Color : uint8_t { Black = 0, White = 1 };
+// headings are in clockwise order, so that turning is just adding one (right) or three
+// (left) modulo four, and a heading can index straight into the movement tables
+enum class Direction : uint8_t { Up, Right, Down, Left };
 using Position = std::pair<int, int>;
 
+// {{{ HULL GRID
+
+// Sparse 2D grid of panel colors, stored as dense 64x64 chunks which are allocated on
+// demand and found through a flat hash map of chunk coordinates. Each cell is one color
+// byte plus one 'painted' bit. The robot moves one cell at a time, so the last chunk used
+// is cached and almost every access skips the hash lookup entirely.
+class HullGrid {
+    static constexpr int CHUNK_BITS = 6;
+    static constexpr int CHUNK_SIZE = 1 << CHUNK_BITS;
+    static constexpr int CHUNK_MASK = CHUNK_SIZE - 1;
+
+    struct Chunk {
+        uint8_t color[CHUNK_SIZE * CHUNK_SIZE];
+        uint64_t painted[CHUNK_SIZE];  // one bit per cell, one word per row
+
+        Chunk(void) : color(), painted() {}
+    };
+
+    ska::flat_hash_map<uint64_t, std::unique_ptr<Chunk>> m_chunks;
+
+    uint64_t m_cached_key;
+    Chunk* m_cached_chunk;
+
+    // bounding box of all painted cells, kept up to date so printing needs no extra pass
+    int m_xmin, m_xmax, m_ymin, m_ymax;
+
+    static inline uint64_t chunk_key(int x, int y)
+    {
+        const uint32_t cx = static_cast<uint32_t>(x >> CHUNK_BITS);
+        const uint32_t cy = static_cast<uint32_t>(y >> CHUNK_BITS);
+        return (uint64_t(cx) << 32) | cy;
+    }
+
+    inline Chunk* find_chunk(int x, int y) const
+    {
+        const uint64_t key = chunk_key(x, y);
+        if (key == m_cached_key) return m_cached_chunk;
+
+        auto it = m_chunks.find(key);
+        return it == m_chunks.end() ? nullptr : it->second.get();
+    }
+
+    inline Chunk& get_or_create_chunk(int x, int y)
+    {
+        const uint64_t key = chunk_key(x, y);
+        if (key == m_cached_key) return *m_cached_chunk;
+
+        auto& chunk = m_chunks[key];
+        if (!chunk) chunk = std::make_unique<Chunk>();
+
+        m_cached_key = key;
+        m_cached_chunk = chunk.get();
+        return *chunk;
+    }
+
+public:
+    HullGrid(void)
+        : m_cached_key(~chunk_key(0, 0)),
+          m_cached_chunk(nullptr),
+          m_xmin(std::numeric_limits<int>::max()),
+          m_xmax(std::numeric_limits<int>::min()),
+          m_ymin(std::numeric_limits<int>::max()),
+          m_ymax(std::numeric_limits<int>::min())
+    {
+        // start with the origin chunk in the cache so the cache pointer is never null
+        get_or_create_chunk(0, 0);
+    }
+
+    inline Color color_at(int x, int y) const
+    {
+        const Chunk* chunk = find_chunk(x, y);
+        if (!chunk) return Color::Black;
+        return Color(chunk->color[(y & CHUNK_MASK) * CHUNK_SIZE + (x & CHUNK_MASK)]);
+    }
+
+    // returns true if this panel had never been painted before
+    inline bool paint(int x, int y, Color col)
+    {
+        Chunk& chunk = get_or_create_chunk(x, y);
+        const int cx = x & CHUNK_MASK;
+        const int cy = y & CHUNK_MASK;
+
+        chunk.color[cy * CHUNK_SIZE + cx] = uint8_t(col);
+
+        const uint64_t bit = uint64_t(1) << cx;
+        if (chunk.painted[cy] & bit) return false;
+        chunk.painted[cy] |= bit;
+
+        m_xmin = std::min(m_xmin, x);
+        m_xmax = std::max(m_xmax, x);
+        m_ymin = std::min(m_ymin, y);
+        m_ymax = std::max(m_ymax, y);
+        return true;
+    }
+
+    int xmin(void) const { return m_xmin; }
+    int xmax(void) const { return m_xmax; }
+    int ymin(void) const { return m_ymin; }
+    int ymax(void) const { return m_ymax; }
+
+    size_t chunk_count(void) const { return m_chunks.size(); }
+};
+
+// }}}
+
 class HullPaintingRobot {
     IntCodeVM m_computer;
-    std::map<Position, Color> m_hull;
+    HullGrid m_hull;
     Position m_position;
     Direction m_direction;
     size_t m_panels_painted;
 
-    inline Color color_at(Position pos)
-    {
-        auto it = m_hull.find(pos);
-        return it == m_hull.end() ? Color::Black : it->second;
-    }
+    inline Color color_at(Position pos) { return m_hull.color_at(pos.first, pos.second); }
 
     inline void paint_panel(Position pos, Color col)
     {
-        auto it = m_hull.find(pos);
-        if (it == m_hull.end()) {
-            m_hull[pos] = col;
+        if (m_hull.paint(pos.first, pos.second, col)) {
             m_panels_painted++;
         }
-        else {
-            it->second = col;
-        }
     }
 
 public:
-    HullPaintingRobot(const char* program_filepath, bool start_on_white)
-        : m_computer(program_filepath),
+    HullPaintingRobot(std::vector<IntType> program, bool start_on_white)
+        : m_computer(std::move(program)),
           m_position({0, 0}),
           m_direction(Direction::Up),
           m_panels_painted(0)
     {
         if (start_on_white) {
-            m_hull[m_position] = Color::White;
+            // the starting panel counts as already painted
+            m_hull.paint(m_position.first, m_position.second, Color::White);
         }
     }
 
     void print_hull(void)
     {
-        // first determine min/max extent that robot painted on hull
-        int x_min = std::numeric_limits<int>::max();
-        int x_max = std::numeric_limits<int>::min();
-        int y_min = std::numeric_limits<int>::max();
-        int y_max = std::numeric_limits<int>::min();
-
-        for (const auto& [pos, _] : m_hull) {
-            x_min = std::min(x_min, pos.first);
-            x_max = std::max(x_max, pos.first);
-            y_min = std::min(y_min, pos.second);
-            y_max = std::max(y_max, pos.second);
-        }
-
         // starting from the top, print the rows of painted squares
-        for (auto y = y_max; y >= y_min; y--) {
-            for (auto x = x_min; x <= x_max; x++) {
-                auto it = m_hull.find({x, y});
-                if (it != m_hull.end()) {
-                    std::cout << (it->second == Color::White ? "*" : " ");
-                }
-                else {
-                    std::cout << " ";
-                }
+        for (auto y = m_hull.ymax(); y >= m_hull.ymin(); y--) {
+            for (auto x = m_hull.xmin(); x <= m_hull.xmax(); x++) {
+                std::cout << (m_hull.color_at(x, y) == Color::White ? "*" : " ");
             }
             std::cout << std::endl;
         }
     }
 
-    size_t paint(void)
+    HullPaintingRobot(const char* program_filepath, bool start_on_white)
+        : HullPaintingRobot(read_program_from_file(program_filepath), start_on_white)
+    {
+    }
+
+    bool is_halted(void) const { return m_computer.is_halted(); }
+
+    // paint until the program halts, or until 'max_steps' panels have been painted for
+    // programs which might never halt
+    size_t paint(size_t max_steps = std::numeric_limits<size_t>::max())
     {
         assert(m_panels_painted == 0);
 
-        bool still_painting = true;
-        while (still_painting) {
-            Color color_underneath_robot = color_at(m_position);
-
-            auto output = m_computer.continue_execution(color_underneath_robot == Color::Black ? 0 : 1);
-
-            if (output) {
-                paint_panel(m_position, *output == 0 ? Color::Black : Color::White);
-                output = m_computer.continue_execution({});
-                assert(output);  // robot should always return direction to turn
-
-                switch (*output) {
-                    case 0:  // turn left 90 degrees
-                        switch (m_direction) {
-                            case Direction::Up:
-                                m_direction = Direction::Left;
-                                break;
-                            case Direction::Down:
-                                m_direction = Direction::Right;
-                                break;
-                            case Direction::Left:
-                                m_direction = Direction::Down;
-                                break;
-                            case Direction::Right:
-                                m_direction = Direction::Up;
-                                break;
-                        }
-                        break;
-                    case 1:  // turn right 90 degrees
-                        switch (m_direction) {
-                            case Direction::Up:
-                                m_direction = Direction::Right;
-                                break;
-                            case Direction::Down:
-                                m_direction = Direction::Left;
-                                break;
-                            case Direction::Left:
-                                m_direction = Direction::Up;
-                                break;
-                            case Direction::Right:
-                                m_direction = Direction::Down;
-                                break;
-                        }
-                        break;
-                    default:
-                        std::cerr << "ERROR: invalid robot turn direction output encountered."
-                                  << std::endl;
-                        exit(EXIT_FAILURE);
-                }
+        static constexpr int dx[4] = {0, 1, 0, -1};
+        static constexpr int dy[4] = {1, 0, -1, 0};
+
+        std::vector<IntType> outputs;
+        outputs.reserve(16);
+
+        int heading = int(m_direction);
+        size_t step = 0;
+
+        while (step < max_steps && !m_computer.is_halted()) {
+            // one VM entry per input: collect every (color, turn) pair the program produces
+            // before it asks for the next color, then apply them all in one tight loop
+            outputs.clear();
+            m_computer.run_until_input(outputs, IntType(color_at(m_position)));
+            panic_if(outputs.size() % 2 != 0, "Robot program produced an unpaired output.");
+
+            for (size_t i = 0; i < outputs.size() && step < max_steps; i += 2, step++) {
+                const IntType turn = outputs[i + 1];
+                panic_if(turn != 0 && turn != 1, "Invalid robot turn direction output encountered.");
+
+                paint_panel(m_position, Color(outputs[i]));
+                heading = (heading + (turn == 0 ? 3 : 1)) & 3;
+                m_position.first += dx[heading];
+                m_position.second += dy[heading];
+            }
+        }
+
+        m_direction = Direction(heading);
+
+        assert(m_computer.is_halted() || max_steps != std::numeric_limits<size_t>::max());
+
+        return m_panels_painted;
+    }
+};
+
+// {{{ BATCH
+
+// Bounded multi-producer multi-consumer queue (Dmitry Vyukov's design). Every cell carries a
+// sequence number which tells producers and consumers whose turn it is to use that cell, so
+// pushing and popping only need a compare-and-swap on the shared position counters.
+template <typename T>
+class LockFreeQueue {
+    struct Cell {
+        std::atomic<size_t> sequence;
+        T data;
+    };
 
-                // now move the robot
-                switch (m_direction) {
-                    case Direction::Up:
-                        m_position.second++;
-                        break;
-                    case Direction::Down:
-                        m_position.second--;
-                        break;
-                    case Direction::Left:
-                        m_position.first--;
-                        break;
-                    case Direction::Right:
-                        m_position.first++;
-                        break;
+    std::unique_ptr<Cell[]> m_buffer;
+    const size_t m_mask;
+
+    alignas(64) std::atomic<size_t> m_enqueue_pos;
+    alignas(64) std::atomic<size_t> m_dequeue_pos;
+
+public:
+    // 'capacity' must be a power of two
+    explicit LockFreeQueue(size_t capacity)
+        : m_buffer(new Cell[capacity]), m_mask(capacity - 1), m_enqueue_pos(0), m_dequeue_pos(0)
+    {
+        panic_if(capacity < 2 || (capacity & (capacity - 1)) != 0,
+                 "Queue capacity must be a power of two.");
+        for (size_t i = 0; i < capacity; i++) {
+            m_buffer[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    bool try_push(const T& value)
+    {
+        size_t pos = m_enqueue_pos.load(std::memory_order_relaxed);
+        while (true) {
+            Cell& cell = m_buffer[pos & m_mask];
+            const size_t seq = cell.sequence.load(std::memory_order_acquire);
+            const intptr_t diff = intptr_t(seq) - intptr_t(pos);
+
+            if (diff == 0) {
+                if (m_enqueue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    cell.data = value;
+                    cell.sequence.store(pos + 1, std::memory_order_release);
+                    return true;
                 }
             }
+            else if (diff < 0) {
+                return false;  // full
+            }
             else {
-                still_painting = false;
+                pos = m_enqueue_pos.load(std::memory_order_relaxed);
             }
         }
+    }
 
-        assert(m_computer.is_halted());
+    bool try_pop(T& value)
+    {
+        size_t pos = m_dequeue_pos.load(std::memory_order_relaxed);
+        while (true) {
+            Cell& cell = m_buffer[pos & m_mask];
+            const size_t seq = cell.sequence.load(std::memory_order_acquire);
+            const intptr_t diff = intptr_t(seq) - intptr_t(pos + 1);
 
-        return m_panels_painted;
+            if (diff == 0) {
+                if (m_dequeue_pos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    value = cell.data;
+                    cell.sequence.store(pos + m_mask + 1, std::memory_order_release);
+                    return true;
+                }
+            }
+            else if (diff < 0) {
+                return false;  // empty
+            }
+            else {
+                pos = m_dequeue_pos.load(std::memory_order_relaxed);
+            }
+        }
     }
 };
 
-int main(void)
+struct RobotJob {
+    size_t program_index;
+    bool start_on_white;
+    size_t max_steps;
+};
+
+struct RobotResult {
+    size_t job_index;
+    size_t panels_painted;
+    bool halted;
+};
+
+// Run every job on its own robot (and so its own VM and grid). Worker threads claim jobs
+// through a shared counter and hand results back through a lock-free queue, which the
+// calling thread drains while the workers run; nothing else is shared between threads.
+std::vector<RobotResult> paint_in_parallel(const std::vector<std::vector<IntType>>& programs,
+                                           const std::vector<RobotJob>& jobs, size_t thread_count)
 {
+    LockFreeQueue<RobotResult> results_queue(1024);
+    std::atomic<size_t> next_job(0);
+
+    auto worker = [&](void) {
+        for (size_t j = next_job++; j < jobs.size(); j = next_job++) {
+            const RobotJob& job = jobs[j];
+            HullPaintingRobot robot(programs[job.program_index], job.start_on_white);
+            const size_t panels = robot.paint(job.max_steps);
+
+            const RobotResult result = {j, panels, robot.is_halted()};
+            while (!results_queue.try_push(result)) std::this_thread::yield();
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < thread_count; t++) threads.emplace_back(worker);
+
+    std::vector<RobotResult> results(jobs.size());
+    for (size_t received = 0; received < jobs.size();) {
+        RobotResult result;
+        if (results_queue.try_pop(result)) {
+            results[result.job_index] = result;
+            received++;
+        }
+        else {
+            std::this_thread::yield();
+        }
+    }
+
+    for (auto& t : threads) t.join();
+
+    return results;
+}
+
+// Sweep every program over both start colors and a range of step budgets, 'job_count' jobs
+// in total, and time the batch for increasing thread counts.
+void run_robot_batch(const std::vector<const char*>& program_paths, size_t job_count)
+{
+    std::vector<std::vector<IntType>> programs;
+    for (const char* path : program_paths) programs.push_back(read_program_from_file(path));
+
+    const size_t step_budgets[] = {250, 1000, 4000, std::numeric_limits<size_t>::max()};
+
+    std::vector<RobotJob> jobs;
+    for (size_t i = 0; jobs.size() < job_count; i++) {
+        jobs.push_back({i % programs.size(), (i / programs.size()) % 2 == 1,
+                        step_budgets[(i / programs.size() / 2) % 4]});
+    }
+
+    const size_t max_threads = std::max(1u, std::thread::hardware_concurrency());
+    int64_t single_thread_time = 0;
+
+    for (size_t threads = 1; threads <= max_threads; threads *= 2) {
+        const auto start_time = std::chrono::steady_clock::now();
+        const auto results = paint_in_parallel(programs, jobs, threads);
+        const auto end_time = std::chrono::steady_clock::now();
+
+        const int64_t time =
+            std::chrono::duration_cast<std::chrono::microseconds>(end_time - start_time).count();
+        if (threads == 1) single_thread_time = time;
+
+        size_t total_panels = 0;
+        size_t halted = 0;
+        for (const RobotResult& r : results) {
+            total_panels += r.panels_painted;
+            halted += r.halted;
+        }
+
+        std::cout << threads << " thread(s): " << jobs.size() << " robots (" << halted
+                  << " halted), " << total_panels << " panels painted in " << time / 1000
+                  << "ms, speedup " << double(single_thread_time) / time << "x" << std::endl;
+    }
+}
+
+// }}}
+
+// Paint 'steps' panels along a random walk, once with the chunked HullGrid and once with
+// the std::map the robot used to use, and report the time taken by each.
+void benchmark_hull_grid(size_t steps)
+{
+    constexpr int dx[4] = {0, 1, 0, -1};
+    constexpr int dy[4] = {1, 0, -1, 0};
+
+    auto run = [&](const char* name, auto&& paint) {
+        std::mt19937_64 rng(12345);
+        int x = 0, y = 0, heading = 0;
+        size_t painted = 0;
+
+        const auto start_time = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < steps; i++) {
+            const uint64_t r = rng();
+            painted += paint(x, y, Color(r & 1));
+            // mostly keep going straight, so the walk spreads out and covers new ground
+            if ((r >> 1) % 8 == 0) heading = (heading + ((r >> 4) & 1 ? 1 : 3)) % 4;
+            x += dx[heading];
+            y += dy[heading];
+        }
+        const auto end_time = std::chrono::steady_clock::now();
+
+        std::cout << name << ": " << painted << " panels painted in "
+                  << std::chrono::duration_cast<std::chrono::milliseconds>(end_time - start_time).count()
+                  << "ms" << std::endl;
+    };
+
+    HullGrid grid;
+    run("chunked grid", [&](int x, int y, Color col) { return grid.paint(x, y, col); });
+
+    std::map<Position, Color> hull;
+    run("std::map", [&](int x, int y, Color col) { return hull.insert_or_assign({x, y}, col).second; });
+}
+
+// usage: 11 [--bench [steps] | --batch [job count] [program files...]]
+int main(int argc, char** argv)
+{
+    if (argc > 1 && std::string(argv[1]) == "--batch") {
+        const size_t job_count = argc > 2 ? std::stoull(argv[2]) : 1000;
+        std::vector<const char*> program_paths(argv + std::min(argc, 3), argv + argc);
+        if (program_paths.empty()) program_paths.push_back("../inputs/11.txt");
+
+        run_robot_batch(program_paths, job_count);
+        return 0;
+    }
+
+    if (argc > 1 && std::string(argv[1]) == "--bench") {
+        benchmark_hull_grid(argc > 2 ? std::stoull(argv[2]) : 20000000);
+        return 0;
+    }
+
     HullPaintingRobot part_one_robot("../inputs/11.txt", false);
     std::cout << "part one answer = " << part_one_robot.paint() << std::endl;
     HullPaintingRobot part_two_robot("../inputs/11.txt", true);
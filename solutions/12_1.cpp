@@ -1,74 +1,65 @@
-#include <array>
 #include <chrono>
-#include <fstream>
 #include <iostream>
-#include <vector>
+#include <random>
+#include <string>
 
-struct MoonAxis {
-    static constexpr size_t MOON_COUNT = 4;
+#include "nbody.hpp"
 
-    std::array<int, MOON_COUNT> pos;
-    std::array<int, MOON_COUNT> vel;
-    const std::array<int, MOON_COUNT> pos_original;
-    const std::array<int, MOON_COUNT> vel_original;
+// Times the pairwise gravity loop against the rank counting kernel on one axis of random
+// bodies, from the puzzle's four up to 'max_bodies', and checks that they agree. The pairwise
+// loop is quadratic, so it gets fewer steps as the body count grows.
+void benchmark_gravity(size_t max_bodies)
+{
+    std::mt19937 rng(1212);
 
-    size_t steps_taken;
+    for (size_t n = 4;; n = std::min(n * 4, max_bodies)) {
+        NBodyAxis start;
+        for (size_t i = 0; i < n; i++) {
+            start.pos.push_back(int64_t(rng() % (2 * n + 1)) - int64_t(n));
+            start.vel.push_back(0);
+        }
+        const size_t steps = std::max<size_t>(1, std::min<size_t>(10000, 200000000 / (n * n)));
 
-    MoonAxis(std::array<int, MOON_COUNT> p)
-        : pos(p), vel({0, 0, 0, 0}), pos_original(p), vel_original(vel), steps_taken(0)
-    {
-    }
-};
+        auto time_kernel = [&](const char* name, void (NBodyAxis::*gravity)(void)) {
+            NBodyAxis axis = start;
+            const auto start_time = std::chrono::steady_clock::now();
+            for (size_t i = 0; i < steps; i++) {
+                (axis.*gravity)();
+                axis.apply_velocity();
+            }
+            const auto end_time = std::chrono::steady_clock::now();
 
-void update(MoonAxis& axis)
-{
-    std::array<int, MoonAxis::MOON_COUNT>& pos = axis.pos;
-    std::array<int, MoonAxis::MOON_COUNT>& vel = axis.vel;
+            const double total_us =
+                std::chrono::duration_cast<std::chrono::microseconds>(end_time - start_time).count();
+            std::cout << n << " bodies, " << name << ": " << total_us / steps << "us per step ("
+                      << steps << " steps)" << std::endl;
+            return axis;
+        };
 
-    for (auto i = 0; i < MoonAxis::MOON_COUNT; i++) {
-        for (auto j = i + 1; j < MoonAxis::MOON_COUNT; j++) {
-            if (pos[i] > pos[j]) {
-                vel[i]--;
-                vel[j]++;
-            }
-            else if (pos[i] < pos[j]) {
-                vel[i]++;
-                vel[j]--;
-            }
-        }
+        const NBodyAxis pairwise = time_kernel("pairwise", &NBodyAxis::apply_gravity_pairwise);
+        const NBodyAxis ranked = time_kernel("ranked", &NBodyAxis::apply_gravity_ranked);
+        assert(pairwise == ranked);
 
-        pos[i] += vel[i];
+        if (n == max_bodies) break;
     }
-
-    axis.steps_taken++;
 }
 
-int main(void)
+// usage: 12_1 [--gravity-bench [max bodies]]
+int main(int argc, char** argv)
 {
     auto start_time = std::chrono::steady_clock::now();
     std::ios_base::sync_with_stdio(false);
     std::cin.tie();
 
-    std::array<MoonAxis, 3> moon_axes = {MoonAxis({3, 5, -10, 8}), MoonAxis({15, -1, 8, 4}),
-                                         MoonAxis({8, -2, 2, -5})};
-
-    for (size_t i = 0; i < 3; i++) {
-        auto& axis = moon_axes[i];
-        while (axis.steps_taken < 1000) {
-            update(axis);
-        }
+    if (argc > 1 && std::string(argv[1]) == "--gravity-bench") {
+        benchmark_gravity(argc > 2 ? std::stoull(argv[2]) : 100000);
+        return 0;
     }
 
-    size_t total_energy = 0;
-    for (auto i = 0; i < 4; i++) {
-        int pot_energy = 0;
-        int kin_energy = 0;
-        for (auto j = 0; j < 3; j++) {
-            pot_energy += std::abs(moon_axes[j].pos[i]);
-            kin_energy += std::abs(moon_axes[j].vel[i]);
-        }
-        total_energy += pot_energy * kin_energy;
-    }
+    NBodySystem system = read_bodies("../inputs/12.txt");
+    system.step(1000);
+
+    const int64_t total_energy = system.total_energy();
 
     auto end_time = std::chrono::steady_clock::now();
 
@@ -1,10 +1,24 @@
+#include <assert.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include <algorithm>
 #include <array>
+#include <atomic>
 #include <chrono>
 #include <fstream>
+#include <future>
 #include <iostream>
 #include <numeric>
+#include <random>
+#include <string>
+#include <thread>
 #include <vector>
 
+#include "nbody.hpp"
+
 struct MoonAxis {
     static constexpr size_t MOON_COUNT = 4;
 
@@ -19,6 +33,16 @@ struct MoonAxis {
         : pos(p), vel({0, 0, 0, 0}), pos_original(p), vel_original(vel), steps_taken(0)
     {
     }
+
+    explicit MoonAxis(const NBodyAxis& axis) : MoonAxis(positions_of(axis)) {}
+
+    static std::array<int64_t, MOON_COUNT> positions_of(const NBodyAxis& axis)
+    {
+        assert(axis.body_count() == MOON_COUNT);
+        std::array<int64_t, MOON_COUNT> p;
+        std::copy(axis.pos.begin(), axis.pos.end(), p.begin());
+        return p;
+    }
 };
 
 template <typename T>
@@ -40,6 +64,99 @@ T lcm(T a, T b)
     return temp ? (a / temp * b) : 0;
 }
 
+// {{{ PACKED AXIS
+// One axis of the system in SIMD registers: the four moons' positions in one 128 bit vector of
+// int32 and their velocities in another. Gravity compares the positions against themselves
+// rotated by one, two and three lanes, which pairs every moon with every other moon, so a
+// whole step is a handful of shuffles, compares and adds with no branches.
+#ifdef __SSE2__
+struct PackedAxis {
+    __m128i pos;
+    __m128i vel;
+
+    static PackedAxis load(const std::array<int64_t, MoonAxis::MOON_COUNT>& p,
+                           const std::array<int64_t, MoonAxis::MOON_COUNT>& v)
+    {
+        return {_mm_set_epi32(p[3], p[2], p[1], p[0]), _mm_set_epi32(v[3], v[2], v[1], v[0])};
+    }
+
+    inline void step(void)
+    {
+        const __m128i r1 = _mm_shuffle_epi32(pos, _MM_SHUFFLE(0, 3, 2, 1));
+        const __m128i r2 = _mm_shuffle_epi32(pos, _MM_SHUFFLE(1, 0, 3, 2));
+        const __m128i r3 = _mm_shuffle_epi32(pos, _MM_SHUFFLE(2, 1, 0, 3));
+
+        // compares give -1 for true: a moon is pulled down by every moon below it and up
+        // by every moon above it
+        __m128i pull = _mm_sub_epi32(_mm_cmpgt_epi32(pos, r1), _mm_cmpgt_epi32(r1, pos));
+        pull = _mm_add_epi32(pull, _mm_sub_epi32(_mm_cmpgt_epi32(pos, r2), _mm_cmpgt_epi32(r2, pos)));
+        pull = _mm_add_epi32(pull, _mm_sub_epi32(_mm_cmpgt_epi32(pos, r3), _mm_cmpgt_epi32(r3, pos)));
+
+        vel = _mm_add_epi32(vel, pull);
+        pos = _mm_add_epi32(pos, vel);
+    }
+
+    friend inline bool operator==(const PackedAxis& a, const PackedAxis& b)
+    {
+        const __m128i same = _mm_and_si128(_mm_cmpeq_epi32(a.pos, b.pos), _mm_cmpeq_epi32(a.vel, b.vel));
+        return _mm_movemask_epi8(same) == 0xffff;
+    }
+};
+#else
+struct PackedAxis {
+    std::array<int32_t, MoonAxis::MOON_COUNT> pos;
+    std::array<int32_t, MoonAxis::MOON_COUNT> vel;
+
+    static PackedAxis load(const std::array<int64_t, MoonAxis::MOON_COUNT>& p,
+                           const std::array<int64_t, MoonAxis::MOON_COUNT>& v)
+    {
+        PackedAxis packed;
+        for (size_t i = 0; i < MoonAxis::MOON_COUNT; i++) {
+            packed.pos[i] = p[i];
+            packed.vel[i] = v[i];
+        }
+        return packed;
+    }
+
+    inline void step(void)
+    {
+        for (size_t i = 0; i < MoonAxis::MOON_COUNT; i++) {
+            for (size_t j = 0; j < MoonAxis::MOON_COUNT; j++) {
+                vel[i] += (pos[j] > pos[i]) - (pos[j] < pos[i]);
+            }
+        }
+        for (size_t i = 0; i < MoonAxis::MOON_COUNT; i++) pos[i] += vel[i];
+    }
+
+    friend inline bool operator==(const PackedAxis& a, const PackedAxis& b)
+    {
+        return a.pos == b.pos && a.vel == b.vel;
+    }
+};
+#endif
+
+inline bool operator!=(const PackedAxis& a, const PackedAxis& b) { return !(a == b); }
+
+// Both layouts hold 32 bit lanes, so a MoonAxis may only be packed if every value the search
+// passes through fits, not just the starting ones. Gravity acts like a potential equal to the
+// sum of pairwise distances, which (give or take a step's worth) trades off against kinetic
+// energy, so that sum never grows much past its starting value plus v^2 / 2. With four
+// moons starting within +/-2^28 it is under 2^31, and a single moon can't swing more than
+// about 2^30 from the others' centre; starting velocities under 2^14 add little on top.
+// Anything else has to use the 64 bit scalar search.
+inline bool fits_packed(const MoonAxis& axis)
+{
+    static_assert(MoonAxis::MOON_COUNT == 4, "the limits below are worked out for four moons");
+    constexpr int64_t POSITION_LIMIT = int64_t(1) << 28;
+    constexpr int64_t VELOCITY_LIMIT = int64_t(1) << 14;
+
+    return std::all_of(axis.pos.begin(), axis.pos.end(),
+                       [](int64_t x) { return x > -POSITION_LIMIT && x < POSITION_LIMIT; }) &&
+           std::all_of(axis.vel.begin(), axis.vel.end(),
+                       [](int64_t v) { return v > -VELOCITY_LIMIT && v < VELOCITY_LIMIT; });
+}
+// }}}
+
 void update(MoonAxis& axis)
 {
     auto& pos = axis.pos;
@@ -63,29 +180,265 @@ void update(MoonAxis& axis)
     axis.steps_taken++;
 }
 
-int main(void)
+// The original scalar search, kept as a reference point for --compare and as the fallback for
+// axes whose values don't fit in a PackedAxis. Returns 0 if the axis hasn't come back within
+// 'max_steps'.
+uint64_t find_return_period_scalar(MoonAxis axis, uint64_t max_steps = UINT64_MAX)
+{
+    while (true) {
+        if (axis.steps_taken == max_steps) return 0;
+        update(axis);
+        if (axis.pos == axis.pos_original && axis.vel == axis.vel_original) return axis.steps_taken;
+    }
+}
+
+// Steps until the axis is back in its starting state. The simulation is reversible (the
+// previous state can be recovered from the current one), so every state lies on a cycle and
+// the first repeat is always of the start state. Returns 0 if the axis hasn't come back
+// within 'max_steps'.
+uint64_t find_return_period(const MoonAxis& axis, uint64_t max_steps = UINT64_MAX)
+{
+    if (!fits_packed(axis)) return find_return_period_scalar(axis, max_steps);
+
+    const PackedAxis start = PackedAxis::load(axis.pos, axis.vel);
+    PackedAxis state = start;
+
+    uint64_t steps = 0;
+    do {
+        if (steps == max_steps) return 0;
+        state.step();
+        steps++;
+    } while (state != start);
+
+    return steps;
+}
+
+// the same search for systems with any number of bodies, on the generic engine
+uint64_t find_return_period(const NBodyAxis& axis)
+{
+    NBodyAxis state = axis;
+
+    uint64_t steps = 0;
+    do {
+        state.step();
+        steps++;
+    } while (state != axis);
+
+    return steps;
+}
+
+struct Cycle {
+    uint64_t tail;    // steps before the state first enters the cycle
+    uint64_t period;  // length of the cycle
+};
+
+// Brent's cycle detection, for systems which needn't ever return to their start state. The
+// hare searches for a repeat in windows of doubling length, with the tortoise parked at the
+// start of each window; once the period is known, the tail is found by walking two states
+// a period apart from the start until they meet. Only ever holds two states in memory.
+Cycle find_cycle_brent(const MoonAxis& axis)
+{
+    // a MoonAxis is always reversible, so the scalar search finds the whole cycle
+    if (!fits_packed(axis)) return {0, find_return_period_scalar(axis)};
+
+    const PackedAxis start = PackedAxis::load(axis.pos, axis.vel);
+
+    uint64_t power = 1;
+    uint64_t period = 1;
+    PackedAxis tortoise = start;
+    PackedAxis hare = start;
+    hare.step();
+    while (tortoise != hare) {
+        if (power == period) {
+            tortoise = hare;
+            power *= 2;
+            period = 0;
+        }
+        hare.step();
+        period++;
+    }
+
+    tortoise = start;
+    hare = start;
+    for (uint64_t i = 0; i < period; i++) hare.step();
+
+    uint64_t tail = 0;
+    while (tortoise != hare) {
+        tortoise.step();
+        hare.step();
+        tail++;
+    }
+
+    return {tail, period};
+}
+
+template <typename Fn>
+uint64_t time_periods(const char* name, const std::array<MoonAxis, 3>& moon_axes, Fn&& find_period)
+{
+    const auto start_time = std::chrono::steady_clock::now();
+    uint64_t answer = 1;
+    for (const auto& axis : moon_axes) answer = lcm<uint64_t>(answer, find_period(axis));
+    const auto end_time = std::chrono::steady_clock::now();
+
+    std::cout << name << ": " << answer << " in "
+              << std::chrono::duration_cast<std::chrono::microseconds>(end_time - start_time).count()
+              << "us" << std::endl;
+    return answer;
+}
+
+using MoonSystem = std::array<MoonAxis, 3>;
+
+uint64_t axis_period(const MoonAxis& axis, bool use_brent)
+{
+    if (!use_brent) return find_return_period(axis);
+
+    const Cycle cycle = find_cycle_brent(axis);
+    assert(cycle.tail == 0);
+    return cycle.period;
+}
+
+// The axes never interact, so each one's period is searched for on its own thread and the
+// system's period is their LCM
+uint64_t system_period(const MoonSystem& system, bool use_brent)
+{
+    std::array<std::future<uint64_t>, 3> periods;
+    for (size_t i = 0; i < 3; i++) {
+        periods[i] = std::async(std::launch::async, [&system, i, use_brent](void) {
+            return axis_period(system[i], use_brent);
+        });
+    }
+
+    uint64_t combined = 1;
+    for (auto& period : periods) combined = lcm<uint64_t>(combined, period.get());
+    return combined;
+}
+
+// Periods of many systems at once. Axis periods vary by orders of magnitude, so rather than
+// split the systems up front, 'thread_count' threads claim the 3 * n axis searches one at a
+// time from a shared counter, and each system's LCM is taken once they're all done.
+std::vector<uint64_t> system_periods(const std::vector<MoonSystem>& systems, size_t thread_count)
+{
+    std::vector<uint64_t> axis_periods(systems.size() * 3);
+    std::atomic<size_t> next_axis(0);
+
+    auto worker = [&](void) {
+        for (size_t i = next_axis++; i < axis_periods.size(); i = next_axis++) {
+            axis_periods[i] = find_return_period(systems[i / 3][i % 3]);
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (size_t t = 1; t < thread_count; t++) threads.emplace_back(worker);
+    worker();
+    for (auto& t : threads) t.join();
+
+    std::vector<uint64_t> periods(systems.size());
+    for (size_t i = 0; i < systems.size(); i++) {
+        periods[i] = lcm(lcm(axis_periods[3 * i], axis_periods[3 * i + 1]), axis_periods[3 * i + 2]);
+    }
+    return periods;
+}
+
+// random systems with puzzle-sized coordinates, timed for increasing thread counts. A good
+// share of random axes take hundreds of millions of steps to come back (or more), so only
+// axes which return within a million steps are kept, to keep the run time predictable.
+void benchmark_system_periods(size_t system_count, size_t max_threads)
+{
+    constexpr uint64_t MAX_AXIS_PERIOD = 1000000;
+
+    std::mt19937 rng(1212);
+    auto random_axis = [&](void) {
+        while (true) {
+            std::array<int64_t, MoonAxis::MOON_COUNT> p;
+            for (auto& c : p) c = int64_t(rng() % 41) - 20;
+            const MoonAxis axis(p);
+            if (find_return_period(axis, MAX_AXIS_PERIOD) != 0) return axis;
+        }
+    };
+
+    std::vector<MoonSystem> systems;
+    systems.reserve(system_count);
+    for (size_t i = 0; i < system_count; i++) {
+        systems.push_back({random_axis(), random_axis(), random_axis()});
+    }
+
+    std::vector<uint64_t> expected;
+    for (size_t threads = 1; threads <= max_threads; threads *= 2) {
+        const auto start_time = std::chrono::steady_clock::now();
+        const std::vector<uint64_t> periods = system_periods(systems, threads);
+        const auto end_time = std::chrono::steady_clock::now();
+
+        std::cout << threads << " thread(s): " << system_count << " systems in "
+                  << std::chrono::duration_cast<std::chrono::milliseconds>(end_time - start_time).count()
+                  << "ms" << std::endl;
+
+        if (expected.empty()) expected = periods;
+        assert(periods == expected);
+    }
+}
+
+// usage: 12_2 [--brent | --compare | --batch [system count] [max threads]]
+int main(int argc, char** argv)
 {
     auto start_time = std::chrono::steady_clock::now();
     std::ios_base::sync_with_stdio(false);
     std::cin.tie();
 
-    std::array<MoonAxis, 3> moon_axes = {MoonAxis({3, 5, -10, 8}), MoonAxis({15, -1, 8, 4}),
-                                         MoonAxis({8, -2, 2, -5})};
+    const std::string mode = argc > 1 ? argv[1] : "";
 
-    std::vector<uint64_t> periods;
-    for (size_t i = 0; i < 3; i++) {
-        auto& axis = moon_axes[i];
-        while (true) {
-            update(axis);
-            if (axis.pos == axis.pos_original && axis.vel == axis.vel_original) {
-                periods.push_back(axis.steps_taken);
-                break;
+    if (mode == "--batch") {
+        benchmark_system_periods(argc > 2 ? std::stoull(argv[2]) : 1000, argc > 3 ? std::stoull(argv[3]) : 8);
+        return 0;
+    }
+
+    const NBodySystem system = read_bodies("../inputs/12.txt");
+
+    // the packed searches are specialised to four moons
+    if (system.body_count() != MoonAxis::MOON_COUNT) {
+        if (!mode.empty()) {
+            std::cerr << mode << " needs exactly " << MoonAxis::MOON_COUNT << " moons, but the input has "
+                      << system.body_count() << std::endl;
+            std::cerr << "usage: " << argv[0] << " [--brent | --compare | --batch [system count] [max threads]]"
+                      << std::endl;
+            return EXIT_FAILURE;
+        }
+        uint64_t period = 1;
+        for (const auto& axis : system.axes) period = lcm(period, find_return_period(axis));
+        std::cout << period << std::endl;
+        return 0;
+    }
+
+    const MoonSystem moon_axes = {MoonAxis(system.axes[0]), MoonAxis(system.axes[1]),
+                                  MoonAxis(system.axes[2])};
+
+    if (mode == "--compare") {
+        const uint64_t scalar = time_periods("scalar update", moon_axes, [](const MoonAxis& axis) {
+            return find_return_period_scalar(axis);
+        });
+        const uint64_t packed =
+            time_periods("packed", moon_axes, [](const MoonAxis& axis) { return find_return_period(axis); });
+        const uint64_t brent =
+            time_periods("brent", moon_axes, [](const MoonAxis& axis) { return find_cycle_brent(axis).period; });
+        assert(scalar == packed && packed == brent);
+
+        // A lone moon far from the other three swings out to about twice the starting range,
+        // so these once overflowed the packed int32 lanes; the 2^28 - 1 pair is the widest
+        // that still takes the packed path.
+        for (const int64_t l : {(int64_t(1) << 30) - 1, (int64_t(1) << 28) - 1}) {
+            for (const MoonAxis& axis : {MoonAxis({-l, l, l, l}), MoonAxis({-l, -l, -l, l})}) {
+                const uint64_t expected = find_return_period_scalar(axis);
+                const uint64_t period = find_return_period(axis);
+                const uint64_t cycle = find_cycle_brent(axis).period;
+                std::cout << "wide axis {" << axis.pos[0] << ", " << axis.pos[1] << ", " << axis.pos[2]
+                          << ", " << axis.pos[3] << "}: " << expected << (fits_packed(axis) ? " (packed)" : "")
+                          << (period == expected && cycle == expected ? "" : " MISMATCH") << std::endl;
+                if (period != expected || cycle != expected) return EXIT_FAILURE;
             }
         }
+        return 0;
     }
 
-    std::cout << std::accumulate(periods.begin(), periods.end(), (uint64_t)1, lcm<uint64_t>)
-              << std::endl;
+    std::cout << system_period(moon_axes, mode == "--brent") << std::endl;
 
     auto end_time = std::chrono::steady_clock::now();
 
@@ -9,7 +9,8 @@ int main(void)
 
     while (!vm.is_halted()) {
         auto output = vm.continue_execution({});
-        if (output) output_count++;
+        if (!output) continue;
+        output_count++;
         if (output_count % 3 == 0 && *output == 2) {
             block_count++;
         }
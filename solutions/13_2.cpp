@@ -1,124 +1,335 @@
 #include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
 #include <iostream>
-#include <map>
+#include <limits>
+#include <mutex>
 #include <numeric>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_set>
 #include <utility>
+#include <vector>
 
 #include "intcode.hpp"
 
 class ArcadeCabinet {
+public:
+    enum class TileState : uint8_t { Empty, Wall, Block, Paddle, Ball };
+
+private:
     IntCodeVM m_computer;
 
-    enum class TileState { Empty, Wall, Block, Paddle, Ball };
-    std::map<std::pair<int, int>, TileState> m_screen;
+    // The game never draws outside a small fixed area (40x21 for inputs/13.txt), so the
+    // screen is a dense row-major array, pre-sized up front and only grown if a program
+    // draws outside of it.
+    static constexpr int INITIAL_SCREEN_WIDTH = 64;
+    static constexpr int INITIAL_SCREEN_HEIGHT = 32;
+
+    std::vector<uint8_t> m_screen;
+    int m_width, m_height;
+
+    // bounding box of everything drawn so far, and of the tiles changed since the last render
+    int m_xmax, m_ymax;
+    int m_dirty_xmin, m_dirty_xmax, m_dirty_ymin, m_dirty_ymax;
+    bool m_rendered_once;
+
+    IntType m_score;
+    size_t m_blocks_remaining;
+    size_t m_ticks;
+
+    // last drawn positions of the ball and paddle, tracked from the output stream
+    int m_ball_x, m_ball_y;
+    int m_paddle_x, m_paddle_y;
+    int m_ball_dx, m_ball_dy;  // zero until the ball has been seen moving
+
+    void grow_screen(int min_width, int min_height)
+    {
+        const int new_width = std::max(m_width, min_width);
+        const int new_height = std::max(m_height, min_height);
+
+        std::vector<uint8_t> new_screen(new_width * new_height, uint8_t(TileState::Empty));
+        for (int y = 0; y < m_height; y++) {
+            std::copy_n(&m_screen[y * m_width], m_width, &new_screen[y * new_width]);
+        }
 
-    int m_xmax, m_xmin, m_ymin, m_ymax;
-    int m_score;
+        m_screen = std::move(new_screen);
+        m_width = new_width;
+        m_height = new_height;
+    }
 
     void set_screen_tile(int x, int y, TileState state)
     {
-        m_screen[{x, y}] = state;
+        panic_if(x < 0 || y < 0, "Arcade program drew a tile at a negative coordinate.");
+        if (x >= m_width || y >= m_height) grow_screen(2 * (x + 1), 2 * (y + 1));
+
+        uint8_t& tile = m_screen[y * m_width + x];
+        if (tile == uint8_t(state)) return;
+
+        if (tile == uint8_t(TileState::Block)) m_blocks_remaining--;
+        if (state == TileState::Block) m_blocks_remaining++;
+        tile = uint8_t(state);
+
+        if (state == TileState::Ball) {
+            if (m_ball_x != 0 || m_ball_y != 0) {
+                m_ball_dx = x - m_ball_x;
+                m_ball_dy = y - m_ball_y;
+            }
+            m_ball_x = x;
+            m_ball_y = y;
+        }
+        else if (state == TileState::Paddle) {
+            m_paddle_x = x;
+            m_paddle_y = y;
+        }
+
         m_xmax = std::max(m_xmax, x);
-        m_xmin = std::min(m_xmin, x);
-        m_ymax = std::max(m_ymax, x);
-        m_ymin = std::min(m_ymin, x);
+        m_ymax = std::max(m_ymax, y);
+        m_dirty_xmin = std::min(m_dirty_xmin, x);
+        m_dirty_xmax = std::max(m_dirty_xmax, x);
+        m_dirty_ymin = std::min(m_dirty_ymin, y);
+        m_dirty_ymax = std::max(m_dirty_ymax, y);
+    }
+
+    void clear_dirty_rectangle(void)
+    {
+        m_dirty_xmin = std::numeric_limits<int>::max();
+        m_dirty_ymin = std::numeric_limits<int>::max();
+        m_dirty_xmax = std::numeric_limits<int>::min();
+        m_dirty_ymax = std::numeric_limits<int>::min();
     }
 
-    void clear_screen(void)
+    static char tile_glyph(TileState state)
     {
-        m_screen.clear();
-        m_xmax = std::numeric_limits<int>::min();
-        m_xmin = std::numeric_limits<int>::max();
-        m_ymax = std::numeric_limits<int>::min();
-        m_ymin = std::numeric_limits<int>::max();
+        switch (state) {
+            case TileState::Empty:
+                return ' ';
+            case TileState::Wall:
+                return 'X';
+            case TileState::Block:
+                return '#';
+            case TileState::Paddle:
+                return '^';
+            case TileState::Ball:
+                return '0';
+        };
+        return '?';
     }
 
 public:
-    ArcadeCabinet(const char* filepath) : m_computer(filepath)
+    ArcadeCabinet(const char* filepath)
+        : m_computer(filepath),
+          m_screen(INITIAL_SCREEN_WIDTH * INITIAL_SCREEN_HEIGHT, uint8_t(TileState::Empty)),
+          m_width(INITIAL_SCREEN_WIDTH),
+          m_height(INITIAL_SCREEN_HEIGHT),
+          m_xmax(0),
+          m_ymax(0),
+          m_rendered_once(false),
+          m_score(0),
+          m_blocks_remaining(0),
+          m_ticks(0),
+          m_ball_x(0),
+          m_ball_y(0),
+          m_paddle_x(0),
+          m_paddle_y(0),
+          m_ball_dx(0),
+          m_ball_dy(0)
     {
+        clear_dirty_rectangle();
         m_computer.write_memory(0, 2);
     }
 
+    IntType score(void) const { return m_score; }
+    size_t blocks_remaining(void) const { return m_blocks_remaining; }
+    size_t ticks(void) const { return m_ticks; }
+    bool is_game_over(void) const { return m_computer.is_halted(); }
+
+    int ball_x(void) const { return m_ball_x; }
+    int paddle_x(void) const { return m_paddle_x; }
+
+    // joystick input which moves the paddle one step closer to being under the ball
+    int autopilot_input(void) const { return (m_ball_x > m_paddle_x) - (m_ball_x < m_paddle_x); }
+
+    struct ContactPrediction {
+        int x;      // column the ball will be in when it is just above the paddle row
+        int ticks;  // ticks until the ball reaches that position
+        int dx;     // horizontal direction of the ball at that point
+    };
+
+    // Simulate the ball's flight on a scratch copy of the framebuffer until it is next about
+    // to bounce off the paddle row. The game's bounce rule (reverse engineered, and checked
+    // against every frame of inputs/13.txt) is: flip dx if the cell beside the ball is solid,
+    // flip dy if the cell above/below is solid, flip both if the diagonal cell is solid,
+    // repeating until none of those cells are solid, then move. Blocks break when hit.
+    std::optional<ContactPrediction> predict_paddle_contact(void) const
+    {
+        if (m_ball_dx == 0 || m_ball_dy == 0) return {};
+
+        std::vector<uint8_t> screen = m_screen;
+        int x = m_ball_x, y = m_ball_y;
+        int dx = m_ball_dx, dy = m_ball_dy;
+
+        auto hit = [&](int hx, int hy) {
+            // assume the paddle will be in place, so the whole paddle row is solid
+            if (hy == m_paddle_y) return true;
+            if (hx < 0 || hy < 0 || hx >= m_width || hy >= m_height) return true;
+
+            uint8_t& tile = screen[hy * m_width + hx];
+            if (tile == uint8_t(TileState::Block)) {
+                tile = uint8_t(TileState::Empty);
+                return true;
+            }
+            return tile == uint8_t(TileState::Wall);
+        };
+
+        // the ball can't bounce around forever without coming back down, but guard anyway
+        const int max_ticks = 16 * m_width * m_height;
+
+        for (int ticks = 0; ticks < max_ticks; ticks++) {
+            if (y == m_paddle_y - 1 && dy > 0) return ContactPrediction{x, ticks, dx};
+            if (y >= m_paddle_y) return {};  // the paddle already missed the ball
+
+            // a ball boxed in on all sides would bounce in place forever
+            int bounces = 0;
+            for (bool bounced = true; bounced && bounces < 4; bounces++) {
+                bounced = false;
+                if (hit(x + dx, y)) {
+                    dx = -dx;
+                    bounced = true;
+                }
+                if (hit(x, y + dy)) {
+                    dy = -dy;
+                    bounced = true;
+                }
+                if (hit(x + dx, y + dy)) {
+                    dx = -dx;
+                    dy = -dy;
+                    bounced = true;
+                }
+            }
+
+            x += dx;
+            y += dy;
+        }
+
+        return {};
+    }
+
+    // Identifies the visible game state: the framebuffer plus the ball's direction. Two games
+    // with the same hash will (barring collisions) play out identically from here on.
+    size_t state_hash(void) const
+    {
+        size_t h = std::hash<std::string_view>{}(
+            std::string_view(reinterpret_cast<const char*>(m_screen.data()), m_screen.size()));
+        h ^= (m_ball_dx + 2) * 31 + (m_ball_dy + 2) + 0x9e3779b97f4a7c15ULL + (h << 6) + (h >> 2);
+        return h;
+    }
+
+    // false if the ball will reach the paddle row before the paddle can get under it
+    bool can_reach_next_paddle_contact(void) const
+    {
+        const auto contact = predict_paddle_contact();
+        return !contact || std::abs(contact->x - m_paddle_x) <= contact->ticks + 1;
+    }
+
+    // Fill 'plan' with the joystick inputs for every tick up to and including the next
+    // paddle bounce: walk the paddle to the predicted contact column, then hold still.
+    // With 'reverse_ball' set the paddle instead waits one column ahead of the ball, so that
+    // the ball hits its corner and bounces back the way it came.
+    void plan_until_paddle_contact(std::vector<int>& plan, bool reverse_ball = false) const
+    {
+        plan.clear();
+
+        const auto contact = predict_paddle_contact();
+        if (!contact) {
+            plan.push_back(autopilot_input());
+            return;
+        }
+
+        // the paddle moves before the ball within a tick, so it gets one extra move
+        const int target_x = contact->x + (reverse_ball ? contact->dx : 0);
+        const int distance = target_x - m_paddle_x;
+        const int direction = (distance > 0) - (distance < 0);
+
+        plan.resize(contact->ticks + 1, 0);
+        for (int i = 0; i < std::min<int>(std::abs(distance), plan.size()); i++) {
+            plan[i] = direction;
+        }
+    }
+
+    TileState tile_at(int x, int y) const
+    {
+        if (x < 0 || y < 0 || x >= m_width || y >= m_height) return TileState::Empty;
+        return TileState(m_screen[y * m_width + x]);
+    }
+
+    // Run the game until it next asks for joystick input (or ends), applying every draw
+    // instruction to the framebuffer. No console I/O happens here; call render() for that.
     void tick(int input)
     {
-        clear_screen();
+        assert(!is_game_over());
         m_computer.set_input(input);
+        m_ticks++;
 
         while (true) {
             auto output = m_computer.continue_execution();
             if (!output) {
-                assert(m_computer.get_state() != IntCodeVM::State::Halted);
-                assert(m_computer.get_state() == IntCodeVM::State::AwaitingInput);
+                assert(m_computer.is_halted() ||
+                       m_computer.get_state() == IntCodeVM::State::AwaitingInput);
                 break;
             }
-            const int x = *output;
-            const int y = *m_computer.continue_execution();
-            const int code = *m_computer.continue_execution();
-
-            std::cout << x << " " << y << " " << code << std::endl;
+            const IntType x = *output;
+            const IntType y = *m_computer.continue_execution();
+            const IntType code = *m_computer.continue_execution();
 
             if (x == -1 && y == 0) {
                 m_score = code;
-                break;
             }
             else {
-                switch (code) {
-                    case 0:
-                        set_screen_tile(x, y, TileState::Empty);
-                        break;
-                    case 1:
-                        set_screen_tile(x, y, TileState::Wall);
-                        break;
-                    case 2:
-                        set_screen_tile(x, y, TileState::Block);
-                        break;
-                    case 3:
-                        set_screen_tile(x, y, TileState::Paddle);
-                        break;
-                    case 4:
-                        set_screen_tile(x, y, TileState::Ball);
-                        break;
-                    default:
-                        assert(false);
-                }
+                assert(code >= 0 && code <= 4);
+                set_screen_tile(x, y, TileState(code));
             }
         }
+    }
+
+    // Draw the tiles that changed since the last call. The first call draws the whole screen,
+    // later calls use ANSI cursor movement to only redraw the dirty rectangle.
+    void render(std::ostream& os)
+    {
+        if (!m_rendered_once) {
+            os << "\x1b[2J";
+            m_dirty_xmin = m_dirty_ymin = 0;
+            m_dirty_xmax = m_xmax;
+            m_dirty_ymax = m_ymax;
+            m_rendered_once = true;
+        }
 
-        for (int y = m_ymin; y < m_ymax; y++) {
-            for (int x = m_xmin; x < m_xmax; x++) {
-                switch (m_screen[{x, y}]) {
-                    case TileState::Empty:
-                        std::cout << " ";
-                        break;
-                    case TileState::Wall:
-                        std::cout << "X";
-                        break;
-                    case TileState::Block:
-                        std::cout << "#";
-                        break;
-                    case TileState::Paddle:
-                        std::cout << "^";
-                        break;
-                    case TileState::Ball:
-                        std::cout << "0";
-                        break;
-                };
+        std::string row;
+        for (int y = m_dirty_ymin; y <= m_dirty_ymax; y++) {
+            row.clear();
+            for (int x = m_dirty_xmin; x <= m_dirty_xmax; x++) {
+                row.push_back(tile_glyph(tile_at(x, y)));
             }
-            std::cout << std::endl;
+            // ANSI cursor positions are 1-based
+            os << "\x1b[" << y + 1 << ";" << m_dirty_xmin + 1 << "H" << row;
         }
+
+        os << "\x1b[" << m_ymax + 2 << ";1H\x1b[Kscore: " << m_score << std::endl;
+
+        clear_dirty_rectangle();
     }
 };
 
-int main(void)
+void play_interactive(ArcadeCabinet& arcade)
 {
-    ArcadeCabinet arcade("../inputs/13.txt");
-    arcade.tick(0);
+    arcade.render(std::cout);
 
     int user_input_code;
-    while (true) {
-        std::cin >> user_input_code;
-
-        std::cout << "user input was" << user_input_code << std::endl;
+    while (!arcade.is_game_over()) {
+        if (!(std::cin >> user_input_code)) break;
 
         if (user_input_code == 1) {
             arcade.tick(-1);
@@ -131,7 +342,288 @@ int main(void)
         }
         else {
             std::cerr << "wrong input" << std::endl;
+            continue;
+        }
+
+        arcade.render(std::cout);
+    }
+}
+
+// Keep the paddle under the ball until the game ends. With 'fast_forward' set nothing is
+// rendered, so the game runs as fast as the VM allows.
+void play_autopilot(ArcadeCabinet& arcade, bool fast_forward)
+{
+    while (!arcade.is_game_over()) {
+        arcade.tick(arcade.autopilot_input());
+        if (!fast_forward) arcade.render(std::cout);
+    }
+}
+
+// Like play_autopilot, but only inspects the screen when the ball is about to hit the
+// paddle, batching up the joystick inputs for the whole flight in between.
+void play_predictive(ArcadeCabinet& arcade)
+{
+    std::vector<int> plan;
+    size_t next_move = 0;
+
+    while (!arcade.is_game_over()) {
+        if (next_move == plan.size()) {
+            arcade.plan_until_paddle_contact(plan);
+            next_move = 0;
+        }
+        arcade.tick(plan[next_move++]);
+    }
+}
+
+// time full games with the per-frame autopilot and with the predictive driver
+void compare_drivers(size_t games)
+{
+    for (bool predictive : {false, true}) {
+        int64_t total_time = 0;
+        IntType score = 0;
+
+        for (size_t i = 0; i < games; i++) {
+            const auto start_time = std::chrono::steady_clock::now();
+
+            ArcadeCabinet arcade("../inputs/13.txt");
+            arcade.tick(0);
+            if (predictive) {
+                play_predictive(arcade);
+            }
+            else {
+                play_autopilot(arcade, true);
+            }
+
+            const auto end_time = std::chrono::steady_clock::now();
+            total_time +=
+                std::chrono::duration_cast<std::chrono::microseconds>(end_time - start_time).count();
+            score = arcade.score();
+        }
+
+        std::cout << (predictive ? "predictive" : "autopilot") << ": score = " << score
+                  << ", mean game time = " << total_time / games << "us" << std::endl;
+    }
+}
+
+// {{{ SEARCH
+
+// Branching search over paddle strategies. Every paddle contact is a decision point: the
+// paddle can either meet the ball head on, or catch it on the corner to send it back the
+// way it came. Starting from one game state, each round clones every in-flight game once
+// per choice and plays it to its next contact in parallel, then keeps the best 'beam_width'
+// games. A game's quality is its score, then the fewest blocks left, then the fewest ticks.
+// Games where the paddle can no longer reach the ball in time are dropped straight away.
+// Reversing the ball can also trap it in a loop that never breaks another block, so a game
+// that goes 'stall_limit' contacts without scoring is dropped too.
+struct SearchResult {
+    IntType score;
+    size_t blocks_remaining;
+    size_t ticks;
+    std::vector<uint8_t> choices;  // 1 for every contact where the ball was reversed
+};
+
+SearchResult search_high_score(const ArcadeCabinet& start, size_t beam_width, size_t max_contacts,
+                               size_t stall_limit, size_t thread_count)
+{
+    struct Branch {
+        ArcadeCabinet arcade;
+        std::vector<uint8_t> choices;
+        size_t contacts_since_score;
+    };
+
+    auto is_better = [](const ArcadeCabinet& a, const ArcadeCabinet& b) {
+        if (a.score() != b.score()) return a.score() > b.score();
+        if (a.blocks_remaining() != b.blocks_remaining()) {
+            return a.blocks_remaining() < b.blocks_remaining();
+        }
+        return a.ticks() < b.ticks();
+    };
+
+    std::vector<Branch> frontier = {{start, {}, 0}};
+    std::optional<Branch> best;
+
+    // every child is written to its own slot, so workers only share the next-task index
+    std::vector<std::optional<Branch>> children;
+    std::atomic<size_t> next_child(0);
+
+    auto play_children = [&](void) {
+        std::vector<int> plan;
+        for (size_t c = next_child++; c < children.size(); c = next_child++) {
+            Branch child = frontier[c / 2];
+            const bool reverse_ball = c % 2 == 1;
+            const IntType score_before = child.arcade.score();
+
+            child.arcade.plan_until_paddle_contact(plan, reverse_ball);
+            for (size_t i = 0; i < plan.size() && !child.arcade.is_game_over(); i++) {
+                child.arcade.tick(plan[i]);
+            }
+
+            child.choices.push_back(reverse_ball);
+            child.contacts_since_score =
+                child.arcade.score() > score_before ? 0 : child.contacts_since_score + 1;
+            children[c] = std::move(child);
+        }
+    };
+
+    // The pool is started once for the whole search. Each round bumps 'round' to release the
+    // workers, plays children on this thread too, then waits until every worker has checked
+    // back in; the mutex hand-offs also publish 'frontier' and 'children' between rounds.
+    std::mutex mutex;
+    std::condition_variable round_started;
+    std::condition_variable round_finished;
+    size_t round = 0;
+    size_t workers_busy = 0;
+    bool shutting_down = false;
+
+    auto worker = [&](void) {
+        size_t last_round = 0;
+        while (true) {
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                round_started.wait(lock, [&] { return shutting_down || round != last_round; });
+                if (shutting_down) return;
+                last_round = round;
+            }
+
+            play_children();
+
+            std::lock_guard<std::mutex> lock(mutex);
+            if (--workers_busy == 0) round_finished.notify_one();
         }
+    };
+
+    std::vector<std::thread> threads;
+    for (size_t t = 1; t < thread_count; t++) threads.emplace_back(worker);
+
+    for (size_t contact = 0; contact < max_contacts && !frontier.empty(); contact++) {
+        children.assign(2 * frontier.size(), std::nullopt);
+        next_child = 0;
+
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            workers_busy = threads.size();
+            round++;
+        }
+        round_started.notify_all();
+
+        play_children();
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            round_finished.wait(lock, [&] { return workers_busy == 0; });
+        }
+
+        frontier.clear();
+        for (auto& child : children) {
+            const bool keep_playing = !child->arcade.is_game_over() &&
+                                      child->contacts_since_score <= stall_limit &&
+                                      child->arcade.can_reach_next_paddle_contact();
+            if (keep_playing) {
+                frontier.push_back(std::move(*child));
+            }
+            else if (!best || is_better(child->arcade, best->arcade)) {
+                best = std::move(child);
+            }
+        }
+
+        // Sort best first, then drop games which reached the same state as a better one (the
+        // same position reached again later, typically by looping), then keep the best few.
+        std::sort(frontier.begin(), frontier.end(), [&](const Branch& a, const Branch& b) {
+            return is_better(a.arcade, b.arcade);
+        });
+
+        std::unordered_set<size_t> seen_states;
+        size_t kept = 0;
+        for (size_t i = 0; i < frontier.size() && kept < beam_width; i++) {
+            if (seen_states.insert(frontier[i].arcade.state_hash()).second) {
+                if (kept != i) frontier[kept] = std::move(frontier[i]);
+                kept++;
+            }
+        }
+        frontier.erase(frontier.begin() + kept, frontier.end());
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        shutting_down = true;
+    }
+    round_started.notify_all();
+    for (auto& t : threads) t.join();
+
+    // out of contacts: the best unfinished game still counts
+    for (auto& branch : frontier) {
+        if (!best || is_better(branch.arcade, best->arcade)) best = std::move(branch);
+    }
+
+    assert(best);
+    return {best->arcade.score(), best->arcade.blocks_remaining(), best->arcade.ticks(),
+            std::move(best->choices)};
+}
+
+// }}}
+
+// usage: 13_2 [--interactive | --render | --predictive | --compare | --search [beam width]]
+//     default: autopilot with fast-forward, printing only the final score
+int main(int argc, char** argv)
+{
+    std::ios_base::sync_with_stdio(false);
+
+    const std::string mode = argc > 1 ? argv[1] : "";
+    const bool interactive = mode == "--interactive";
+    const bool render = mode == "--render";
+
+    if (mode == "--compare") {
+        compare_drivers(50);
+        return 0;
+    }
+
+    if (mode == "--search") {
+        const size_t beam_width = argc > 2 ? std::stoul(argv[2]) : 64;
+        const size_t thread_count = std::max(1u, std::thread::hardware_concurrency());
+
+        auto start_time = std::chrono::steady_clock::now();
+
+        ArcadeCabinet arcade("../inputs/13.txt");
+        arcade.tick(0);
+        const auto result = search_high_score(arcade, beam_width, 10000, 64, thread_count);
+
+        auto end_time = std::chrono::steady_clock::now();
+
+        std::cout << "best score: " << result.score << std::endl;
+        std::cout << "blocks remaining: " << result.blocks_remaining << std::endl;
+        std::cout << "ticks: " << result.ticks << std::endl;
+        std::cout << "ball reversals: "
+                  << std::count(result.choices.begin(), result.choices.end(), 1) << " of "
+                  << result.choices.size() << " contacts" << std::endl;
+        std::cout << "search time: "
+                  << std::chrono::duration_cast<std::chrono::microseconds>(end_time - start_time).count()
+                  << "us" << std::endl;
+        return 0;
+    }
+
+    auto start_time = std::chrono::steady_clock::now();
+
+    ArcadeCabinet arcade("../inputs/13.txt");
+    arcade.tick(0);
+
+    if (interactive) {
+        play_interactive(arcade);
+    }
+    else if (mode == "--predictive") {
+        play_predictive(arcade);
+    }
+    else {
+        play_autopilot(arcade, !render);
+    }
+
+    auto end_time = std::chrono::steady_clock::now();
+
+    std::cout << "final score: " << arcade.score() << std::endl;
+    std::cout << "blocks remaining: " << arcade.blocks_remaining() << std::endl;
+
+    if (!interactive) {
+        std::cout << "game computation time: "
+                  << std::chrono::duration_cast<std::chrono::microseconds>(end_time - start_time).count()
+                  << "us" << std::endl;
     }
 
     return 0;
@@ -1,44 +1,45 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <limits>
+#include <queue>
+#include <random>
+#include <thread>
+#include <utility>
+
+#include "mapped_file.hpp"
 #include "prelude.hpp"
 
+[[noreturn]] static void panic(const std::string& msg)
+{
+    std::cerr << "FATAL ERROR: " << msg << std::endl;
+    exit(EXIT_FAILURE);
+}
+
 // {{{ CHEMICAL
+// Chemicals are interned to dense ids by the ReactionGraph they're read into, so they can
+// index flat arrays directly and two distinct labels can never share an id.
 class Chemical {
 public:
-    using Rep = uint64_t;
+    using Rep = uint32_t;
 
 private:
-    static inline Rep hash_resource_label(std::string_view label)
-    {
-        const Rep h = std::hash<std::string_view>{}(label);
-        auto it = s_unhash.find(h);
-        if (it == s_unhash.end()) {
-            s_unhash[h] = std::string(label);
-        }
-        return h;
-    }
-
     Rep m_id;
 
-    static ska::flat_hash_map<Rep, std::string> s_unhash;
-
 public:
     Chemical(void) = delete;
-    Chemical(std::string_view label) : m_id(hash_resource_label(label)) {}
+    explicit Chemical(Rep id) : m_id(id) {}
 
     friend inline bool operator==(const Chemical& r1, const Chemical& r2) { return r1.m_id == r2.m_id; }
     friend inline bool operator!=(const Chemical& r1, const Chemical& r2) { return !(r1 == r2); }
 
     inline Rep id(void) const { return m_id; }
-
-    inline std::string_view name(void) const
-    {
-        auto it = s_unhash.find(m_id);
-        assert(it != s_unhash.end());
-        return it->second;
-    }
 };
 
-ska::flat_hash_map<Chemical::Rep, std::string> Chemical::s_unhash = {};
-
 namespace std {
 template <>
 struct hash<Chemical> {
@@ -48,20 +49,79 @@ struct hash<Chemical> {
 
 // }}}
 
-struct ReactionElement {
-    Chemical resource;
-    uint64_t count;
+// {{{ REACTION GRAPH
+// Every reaction in struct-of-arrays form. Reaction 'r' makes m_yields[r] of m_outputs[r]
+// from the inputs m_input_ids/m_input_counts[m_input_offsets[r] .. m_input_offsets[r + 1]),
+// and m_producers maps each chemical to the reaction making it (NO_REACTION for ORE).
+class ReactionGraph {
+public:
+    static constexpr uint32_t NO_REACTION = std::numeric_limits<uint32_t>::max();
 
-    ReactionElement(void) = delete;
-    ReactionElement(std::string_view label, uint64_t count_) : resource(label), count(count_) {}
-};
+private:
+    // chemical id -> label. A deque never moves its elements, so m_ids can key on views of
+    // these strings and look labels up without building a std::string for each.
+    std::deque<std::string> m_names;
+    ska::flat_hash_map<std::string_view, Chemical::Rep> m_ids;
+    std::vector<uint32_t> m_producers;  // chemical id -> reaction index
+
+    std::vector<Chemical::Rep> m_outputs;
+    std::vector<uint64_t> m_yields;
+    std::vector<uint32_t> m_input_offsets;
+    std::vector<Chemical::Rep> m_input_ids;
+    std::vector<uint64_t> m_input_counts;
 
-struct Reaction {
-    std::vector<ReactionElement> inputs;
-    uint64_t yield;
-};
+public:
+    ReactionGraph(void) : m_input_offsets{0} {}
+
+    Chemical intern(std::string_view label)
+    {
+        auto it = m_ids.find(label);
+        if (it != m_ids.end()) return Chemical(it->second);
+
+        const Chemical::Rep id = m_names.size();
+        m_ids.emplace(m_names.emplace_back(label), id);
+        m_producers.push_back(NO_REACTION);
+        return Chemical(id);
+    }
 
-using ReactionSet = ska::flat_hash_map<Chemical, Reaction>;
+    std::optional<Chemical> find(std::string_view label) const
+    {
+        auto it = m_ids.find(label);
+        if (it == m_ids.end()) return {};
+        return Chemical(it->second);
+    }
+
+    std::string_view name(Chemical c) const { return m_names[c.id()]; }
+
+    // start a reaction making 'yield' of 'output'; its inputs follow via add_input()
+    void begin_reaction(Chemical output, uint64_t yield)
+    {
+        assert(m_producers[output.id()] == NO_REACTION);  // one reaction per chemical
+        m_producers[output.id()] = m_outputs.size();
+        m_outputs.push_back(output.id());
+        m_yields.push_back(yield);
+        m_input_offsets.push_back(m_input_offsets.back());
+    }
+
+    void add_input(Chemical input, uint64_t count)
+    {
+        m_input_ids.push_back(input.id());
+        m_input_counts.push_back(count);
+        m_input_offsets.back()++;
+    }
+
+    size_t chemical_count(void) const { return m_names.size(); }
+    size_t reaction_count(void) const { return m_outputs.size(); }
+
+    uint32_t producer(Chemical c) const { return m_producers[c.id()]; }
+    Chemical output(uint32_t reaction) const { return Chemical(m_outputs[reaction]); }
+    uint64_t yield(uint32_t reaction) const { return m_yields[reaction]; }
+    uint32_t inputs_begin(uint32_t reaction) const { return m_input_offsets[reaction]; }
+    uint32_t inputs_end(uint32_t reaction) const { return m_input_offsets[reaction + 1]; }
+    Chemical input(uint32_t i) const { return Chemical(m_input_ids[i]); }
+    uint64_t input_count(uint32_t i) const { return m_input_counts[i]; }
+};
+// }}}
 
 class Surplus {
     ska::flat_hash_map<Chemical, uint64_t> m_counts;
@@ -69,12 +129,11 @@ class Surplus {
 public:
     void assign(Chemical c, uint64_t count)
     {
-        auto it = m_counts.find(c);
-        if (it != m_counts.end()) {
-            it->second++;
+        if (count == 0) {
+            m_counts.erase(c);
         }
         else {
-            m_counts[c] = 1;
+            m_counts[c] = count;
         }
     }
 
@@ -88,79 +147,833 @@ public:
             return it->second;
         }
     }
+
+    // total units left over across every chemical
+    uint64_t total(void) const
+    {
+        uint64_t sum = 0;
+        for (const auto& [c, count] : m_counts) sum += count;
+        return sum;
+    }
+
+    size_t chemical_count(void) const { return m_counts.size(); }
+};
+
+using Demand = std::pair<Chemical, uint64_t>;
+
+struct ProductionPlan {
+    uint64_t ore;
+    Surplus leftovers;
+};
+
+// {{{ PARSER
+[[noreturn]] static void parse_error(const char* position, const char* end, const char* msg)
+{
+    const char* line_end = std::find(position, end, '\n');
+    std::cerr << "Malformed reaction (" << msg << ") at: '" << std::string_view(position, line_end - position)
+              << "'" << std::endl;
+    exit(EXIT_FAILURE);
+}
+
+// Parse "7 A, 1 B => 1 C" lines straight into 'reactions' in a single pass, with no per line
+// allocation: labels are interned from views into 'text'. Each line is echoed if 'verbose'.
+void parse_reactions(std::string_view text, ReactionGraph& reactions, bool verbose = false)
+{
+    const char* p = text.data();
+    const char* const end = p + text.size();
+
+    auto skip_spaces = [&](void) {
+        while (p < end && (*p == ' ' || *p == '\t' || *p == '\r')) p++;
+    };
+    // counts and yields are both at least 1: a reaction making nothing would divide by zero,
+    // and one taking none of an input isn't really using it
+    auto parse_count = [&](void) -> uint64_t {
+        skip_spaces();
+        if (p == end || *p < '0' || *p > '9') parse_error(p, end, "expected a count");
+        const char* start = p;
+        uint64_t value = 0;
+        while (p < end && *p >= '0' && *p <= '9') {
+            const uint64_t digit = *p++ - '0';
+            if (value > (std::numeric_limits<uint64_t>::max() - digit) / 10) {
+                parse_error(start, end, "count too large");
+            }
+            value = value * 10 + digit;
+        }
+        if (value == 0) parse_error(start, end, "count must be at least 1");
+        return value;
+    };
+    auto parse_label = [&](void) -> std::string_view {
+        skip_spaces();
+        const char* start = p;
+        while (p < end && ((*p >= 'A' && *p <= 'Z') || (*p >= 'a' && *p <= 'z') || (*p >= '0' && *p <= '9'))) {
+            p++;
+        }
+        if (p == start) parse_error(p, end, "expected a chemical");
+        return {start, size_t(p - start)};
+    };
+
+    // reused across lines, so it stops allocating once it's as long as the longest reaction
+    std::vector<std::pair<Chemical, uint64_t>> inputs;
+
+    while (true) {
+        skip_spaces();
+        while (p < end && *p == '\n') {
+            p++;
+            skip_spaces();
+        }
+        if (p == end) break;
+
+        const char* line_start = p;
+        inputs.clear();
+        while (true) {
+            const uint64_t count = parse_count();
+            inputs.emplace_back(reactions.intern(parse_label()), count);
+            skip_spaces();
+            if (p < end && *p == ',') {
+                p++;
+                continue;
+            }
+            if (end - p < 2 || p[0] != '=' || p[1] != '>') parse_error(p, end, "expected '=>'");
+            p += 2;
+            break;
+        }
+
+        const uint64_t yield = parse_count();
+        reactions.begin_reaction(reactions.intern(parse_label()), yield);
+        for (const auto& [input, count] : inputs) reactions.add_input(input, count);
+
+        skip_spaces();
+        if (p < end && *p != '\n') parse_error(p, end, "expected end of line");
+        if (verbose) std::cout << std::string_view(line_start, p - line_start) << '\n';
+    }
+}
+
+void read_reactions(const char* filepath, ReactionGraph& reactions, bool verbose = false)
+{
+    const MappedFile file(filepath);
+    parse_reactions(file.contents(), reactions, verbose);
+}
+// }}}
+
+// {{{ ORE COST SOLVER
+// Orders the reactions that the products depend on so that every chemical comes after all of
+// the chemicals consuming it. The total demand for a chemical is then known by the time it's
+// reached, so one linear pass in that order runs each reaction exactly as often as needed,
+// with leftovers from one consumer's batch shared with every other consumer. The ordered
+// reactions are copied into their own CSR arrays, with inputs renumbered to positions in the
+// order, so a pass only ever walks flat arrays front to back.
+class OreCostSolver {
+    static constexpr uint32_t ORE_INDEX = std::numeric_limits<uint32_t>::max();
+
+    std::vector<uint32_t> m_order;  // reaction indices
+    std::vector<Chemical::Rep> m_outputs;
+    std::vector<uint64_t> m_yields;
+    std::vector<uint32_t> m_input_offsets;
+    std::vector<uint32_t> m_input_steps;  // position in m_order, or ORE_INDEX
+    std::vector<uint64_t> m_input_counts;
+
+    std::vector<uint32_t> m_step_of;  // chemical id -> position in m_order, or ORE_INDEX
+    uint32_t m_product_step;          // the step ore_cost() asks for
+    std::optional<Chemical> m_ore;    // so that plan() can draw ORE from stock
+
+public:
+    OreCostSolver(const ReactionGraph& reactions, Chemical product)
+        : OreCostSolver(reactions, std::vector<Chemical>{product})
+    {
+    }
+
+    // order everything needed by any of 'products'; ore_cost() is for the first of them
+    OreCostSolver(const ReactionGraph& reactions, const std::vector<Chemical>& products)
+    {
+        assert(!products.empty());
+
+        // ORE is the only chemical allowed to have no reaction making it
+        const std::optional<Chemical> ore = reactions.find("ORE");
+        auto check_unproduced = [&](Chemical c) {
+            if (!ore || c != *ore) panic("no reaction produces " + std::string(reactions.name(c)));
+        };
+
+        // number of reactions still to be ordered that consume each reachable chemical's
+        // output, indexed by reaction
+        std::vector<uint32_t> pending_consumers(reactions.reaction_count(), 0);
+        std::vector<bool> reached(reactions.reaction_count(), false);
+        std::vector<uint32_t> stack;
+        for (const Chemical product : products) {
+            const uint32_t r = reactions.producer(product);
+            if (r == ReactionGraph::NO_REACTION) {
+                panic("can't solve for " + std::string(reactions.name(product)) +
+                      ", no reaction produces it");
+            }
+            if (!reached[r]) {
+                reached[r] = true;
+                stack.push_back(r);
+            }
+        }
+        const std::vector<uint32_t> roots = stack;
+        while (!stack.empty()) {
+            const uint32_t r = stack.back();
+            stack.pop_back();
+            for (uint32_t i = reactions.inputs_begin(r); i < reactions.inputs_end(r); i++) {
+                const uint32_t input = reactions.producer(reactions.input(i));
+                if (input == ReactionGraph::NO_REACTION) {
+                    check_unproduced(reactions.input(i));
+                    continue;
+                }
+                pending_consumers[input]++;
+                if (!reached[input]) {
+                    reached[input] = true;
+                    stack.push_back(input);
+                }
+            }
+        }
+
+        // Kahn's algorithm, releasing a reaction once its last consumer has been ordered. A
+        // product which another product consumes is released like any other input.
+        std::vector<uint32_t> position(reactions.reaction_count(), ORE_INDEX);
+        for (const uint32_t r : roots) {
+            if (pending_consumers[r] == 0) stack.push_back(r);
+        }
+        while (!stack.empty()) {
+            const uint32_t r = stack.back();
+            stack.pop_back();
+            position[r] = m_order.size();
+            m_order.push_back(r);
+
+            for (uint32_t i = reactions.inputs_begin(r); i < reactions.inputs_end(r); i++) {
+                const uint32_t input = reactions.producer(reactions.input(i));
+                if (input != ReactionGraph::NO_REACTION && --pending_consumers[input] == 0) {
+                    stack.push_back(input);
+                }
+            }
+        }
+        assert(size_t(std::count(reached.begin(), reached.end(), true)) == m_order.size());
+
+        m_step_of.assign(reactions.chemical_count(), ORE_INDEX);
+        m_input_offsets.reserve(m_order.size() + 1);
+        m_input_offsets.push_back(0);
+        for (const uint32_t r : m_order) {
+            m_step_of[reactions.output(r).id()] = m_outputs.size();
+            m_outputs.push_back(reactions.output(r).id());
+            m_yields.push_back(reactions.yield(r));
+            for (uint32_t i = reactions.inputs_begin(r); i < reactions.inputs_end(r); i++) {
+                const uint32_t input = reactions.producer(reactions.input(i));
+                m_input_steps.push_back(input == ReactionGraph::NO_REACTION ? ORE_INDEX : position[input]);
+                m_input_counts.push_back(reactions.input_count(i));
+            }
+            m_input_offsets.push_back(m_input_steps.size());
+        }
+
+        m_product_step = m_step_of[products.front().id()];
+        m_ore = reactions.find("ORE");
+    }
+
+    size_t reaction_count(void) const { return m_order.size(); }
+    bool contains(Chemical c) const { return m_step_of[c.id()] != ORE_INDEX; }
+
+    // Change how much one reaction yields, or how much of one input it takes, returning the
+    // previous value. Only this solver's copy of the reaction is changed.
+    uint64_t set_yield(Chemical output, uint64_t yield)
+    {
+        assert(yield > 0);
+        const uint32_t step = m_step_of[output.id()];
+        assert(step != ORE_INDEX);
+        return std::exchange(m_yields[step], yield);
+    }
+
+    uint64_t set_input_count(Chemical output, uint32_t input_index, uint64_t count)
+    {
+        const uint32_t step = m_step_of[output.id()];
+        assert(step != ORE_INDEX && input_index < m_input_offsets[step + 1] - m_input_offsets[step]);
+        return std::exchange(m_input_counts[m_input_offsets[step] + input_index], count);
+    }
+
+    friend class IncrementalOreCost;
+
+    // ORE needed to make 'quantity' of the product, in O(reactions)
+    uint64_t ore_cost(uint64_t quantity) const
+    {
+        std::vector<uint64_t> required(m_order.size(), 0);
+        required[m_product_step] = quantity;
+
+        uint64_t ore = 0;
+        for (size_t step = 0; step < m_order.size(); step++) {
+            const uint64_t runs = (required[step] + m_yields[step] - 1) / m_yields[step];
+            for (uint32_t i = m_input_offsets[step]; i < m_input_offsets[step + 1]; i++) {
+                if (m_input_steps[i] == ORE_INDEX) {
+                    ore += runs * m_input_counts[i];
+                }
+                else {
+                    required[m_input_steps[i]] += runs * m_input_counts[i];
+                }
+            }
+        }
+
+        return ore;
+    }
+
+    // Fill several demands at once, drawing on 'stock' before running any reactions. Demands
+    // for the same chemical, or for chemicals feeding each other, all share one pass, so a
+    // batch left over from making one product is used towards the others. Every demanded
+    // chemical must have been passed to the constructor (or be needed by one that was), or
+    // be ORE itself. ORE in stock is used before any more is asked for, so 'ore' in the result
+    // is only what has to be supplied on top of it. Stocked chemicals the demands never touch are carried
+    // through to the leftovers unchanged.
+    ProductionPlan plan(const std::vector<Demand>& demands, const Surplus& stock = {}) const
+    {
+        ProductionPlan result{0, stock};
+
+        std::vector<uint64_t> required(m_order.size(), 0);
+        for (const auto& [chemical, quantity] : demands) {
+            if (m_ore && chemical == *m_ore) {
+                result.ore += quantity;
+                continue;
+            }
+            const uint32_t step = chemical.id() < m_step_of.size() ? m_step_of[chemical.id()] : ORE_INDEX;
+            if (step == ORE_INDEX) {
+                panic("can't plan for chemical " + std::to_string(chemical.id()) +
+                      ", it isn't one this solver was built for");
+            }
+            required[step] += quantity;
+        }
+
+        for (size_t step = 0; step < m_order.size(); step++) {
+            const Chemical output(m_outputs[step]);
+            const uint64_t available = stock.chemical_count() == 0 ? 0 : stock.count(output);
+            const uint64_t shortfall = required[step] > available ? required[step] - available : 0;
+            const uint64_t runs = (shortfall + m_yields[step] - 1) / m_yields[step];
+            result.leftovers.assign(output, available + runs * m_yields[step] - required[step]);
+
+            for (uint32_t i = m_input_offsets[step]; i < m_input_offsets[step + 1]; i++) {
+                if (m_input_steps[i] == ORE_INDEX) {
+                    result.ore += runs * m_input_counts[i];
+                }
+                else {
+                    required[m_input_steps[i]] += runs * m_input_counts[i];
+                }
+            }
+        }
+
+        if (m_ore && stock.chemical_count() != 0) {
+            const uint64_t stocked_ore = stock.count(*m_ore);
+            const uint64_t used = std::min(stocked_ore, result.ore);
+            result.ore -= used;
+            result.leftovers.assign(*m_ore, stocked_ore - used);
+        }
+
+        return result;
+    }
+
+    // Most of the product that 'ore_budget' ORE can make. Leftovers from one unit are used by
+    // the next, so a unit costs at most ore_cost(1) and budget / ore_cost(1) is always
+    // affordable. From there, gallop upwards in doubling steps until a quantity is too
+    // expensive, then binary search the bracket; each probe is one ore_cost() pass.
+    uint64_t max_product(uint64_t ore_budget) const
+    {
+        const uint64_t unit_cost = ore_cost(1);
+        if (unit_cost == 0) panic("the product costs no ORE, so any budget makes unlimited amounts");
+        if (unit_cost > ore_budget) return 0;
+
+        uint64_t affordable = ore_budget / unit_cost;
+        uint64_t step = std::max<uint64_t>(1, affordable / 16);
+        uint64_t too_expensive = affordable + step;
+        while (ore_cost(too_expensive) <= ore_budget) {
+            affordable = too_expensive;
+            step *= 2;
+            too_expensive = affordable + step;
+        }
+
+        while (too_expensive - affordable > 1) {
+            const uint64_t mid = affordable + (too_expensive - affordable) / 2;
+            if (ore_cost(mid) <= ore_budget) {
+                affordable = mid;
+            }
+            else {
+                too_expensive = mid;
+            }
+        }
+
+        return affordable;
+    }
+};
+// }}}
+
+// {{{ INCREMENTAL SOLVER
+// The ore cost of a fixed quantity of a product, kept up to date as the solver's reactions are
+// edited. The required amount and run count of every step are cached; after an edit, only the
+// steps whose run count actually changes are revisited, in topological order, each passing the
+// change in its runs on to its own inputs. Work is proportional to the affected subgraph.
+class IncrementalOreCost {
+    const OreCostSolver* m_solver;
+    uint64_t m_quantity;
+
+    std::vector<uint64_t> m_required;
+    std::vector<uint64_t> m_runs;
+    uint64_t m_ore;
+
+    std::priority_queue<uint32_t, std::vector<uint32_t>, std::greater<uint32_t>> m_dirty;
+    std::vector<bool> m_queued;
+    size_t m_steps_visited;
+
+    void mark_dirty(uint32_t step)
+    {
+        if (!m_queued[step]) {
+            m_queued[step] = true;
+            m_dirty.push(step);
+        }
+    }
+
+    // Consumers always come before their inputs in the order, so popping the lowest dirty step
+    // first means its required amount is final by the time it's visited
+    void propagate(void)
+    {
+        const OreCostSolver& s = *m_solver;
+
+        while (!m_dirty.empty()) {
+            const uint32_t step = m_dirty.top();
+            m_dirty.pop();
+            m_queued[step] = false;
+            m_steps_visited++;
+
+            const uint64_t runs = (m_required[step] + s.m_yields[step] - 1) / s.m_yields[step];
+            if (runs == m_runs[step]) continue;
+            const int64_t delta = int64_t(runs) - int64_t(m_runs[step]);
+            m_runs[step] = runs;
+
+            for (uint32_t i = s.m_input_offsets[step]; i < s.m_input_offsets[step + 1]; i++) {
+                const int64_t change = delta * int64_t(s.m_input_counts[i]);
+                if (s.m_input_steps[i] == OreCostSolver::ORE_INDEX) {
+                    m_ore += change;
+                }
+                else {
+                    m_required[s.m_input_steps[i]] += change;
+                    mark_dirty(s.m_input_steps[i]);
+                }
+            }
+        }
+    }
+
+public:
+    IncrementalOreCost(const OreCostSolver& solver, uint64_t quantity)
+        : m_solver(&solver),
+          m_quantity(quantity),
+          m_required(solver.reaction_count(), 0),
+          m_runs(solver.reaction_count(), 0),
+          m_ore(0),
+          m_queued(solver.reaction_count(), false),
+          m_steps_visited(0)
+    {
+        // starting from zero runs everywhere, one pass over every step is the full solve
+        m_required[solver.m_product_step] = quantity;
+        for (uint32_t step = 0; step < solver.reaction_count(); step++) mark_dirty(step);
+        propagate();
+    }
+
+    uint64_t quantity(void) const { return m_quantity; }
+    uint64_t ore_cost(void) const { return m_ore; }
+    size_t steps_visited(void) const { return m_steps_visited; }
+
+    // call after OreCostSolver::set_yield()
+    void yield_changed(Chemical output)
+    {
+        mark_dirty(m_solver->m_step_of[output.id()]);
+        propagate();
+    }
+
+    // call after OreCostSolver::set_input_count(), with the count it returned
+    void input_count_changed(Chemical output, uint32_t input_index, uint64_t old_count)
+    {
+        const OreCostSolver& s = *m_solver;
+        const uint32_t step = s.m_step_of[output.id()];
+        const uint32_t i = s.m_input_offsets[step] + input_index;
+        const int64_t change = int64_t(m_runs[step]) * (int64_t(s.m_input_counts[i]) - int64_t(old_count));
+
+        if (s.m_input_steps[i] == OreCostSolver::ORE_INDEX) {
+            m_ore += change;
+        }
+        else {
+            m_required[s.m_input_steps[i]] += change;
+            mark_dirty(s.m_input_steps[i]);
+            propagate();
+        }
+    }
+};
+
+// Answers both ore_cost(1) and max_product(budget) across a stream of reaction edits. The max
+// product q is tracked by keeping incremental costs for q and q + 1: as long as q is still
+// affordable and q + 1 still isn't, an edit leaves the answer alone and costs only the affected
+// subgraph. Otherwise the answer is searched for again from scratch.
+class IncrementalSolver {
+    OreCostSolver m_solver;
+    uint64_t m_ore_budget;
+
+    IncrementalOreCost m_unit;
+    std::optional<IncrementalOreCost> m_affordable;
+    std::optional<IncrementalOreCost> m_too_expensive;
+    size_t m_full_searches;
+    size_t m_retired_steps_visited;  // by costs replaced in earlier searches
+
+    void search_max_product(void)
+    {
+        if (m_affordable) {
+            m_retired_steps_visited += m_affordable->steps_visited() + m_too_expensive->steps_visited();
+        }
+
+        const uint64_t max = m_solver.max_product(m_ore_budget);
+        m_affordable.emplace(m_solver, max);
+        m_too_expensive.emplace(m_solver, max + 1);
+        m_full_searches++;
+    }
+
+    template <typename Fn>
+    void for_each_cost(Fn&& fn)
+    {
+        fn(m_unit);
+        fn(*m_affordable);
+        fn(*m_too_expensive);
+
+        if (m_affordable->ore_cost() > m_ore_budget || m_too_expensive->ore_cost() <= m_ore_budget) {
+            search_max_product();
+        }
+    }
+
+public:
+    IncrementalSolver(const ReactionGraph& reactions, Chemical product, uint64_t ore_budget)
+        : m_solver(reactions, product),
+          m_ore_budget(ore_budget),
+          m_unit(m_solver, 1),
+          m_full_searches(0),
+          m_retired_steps_visited(0)
+    {
+        search_max_product();
+    }
+
+    // non-copyable: the incremental costs point at m_solver
+    IncrementalSolver(const IncrementalSolver&) = delete;
+    IncrementalSolver& operator=(const IncrementalSolver&) = delete;
+
+    void set_yield(Chemical output, uint64_t yield)
+    {
+        m_solver.set_yield(output, yield);
+        for_each_cost([&](IncrementalOreCost& cost) { cost.yield_changed(output); });
+    }
+
+    void set_input_count(Chemical output, uint32_t input_index, uint64_t count)
+    {
+        const uint64_t old_count = m_solver.set_input_count(output, input_index, count);
+        for_each_cost(
+            [&](IncrementalOreCost& cost) { cost.input_count_changed(output, input_index, old_count); });
+    }
+
+    const OreCostSolver& solver(void) const { return m_solver; }
+    uint64_t ore_cost(void) const { return m_unit.ore_cost(); }
+    uint64_t max_product(void) const { return m_affordable->quantity(); }
+    size_t full_searches(void) const { return m_full_searches; }
+    size_t steps_visited(void) const
+    {
+        return m_retired_steps_visited + m_unit.steps_visited() + m_affordable->steps_visited() +
+               m_too_expensive->steps_visited();
+    }
 };
+// }}}
 
-uint64_t compute_ore_cost(const ReactionSet& reactions, const Surplus& surplus, Chemical product,
-                          uint64_t quantity)
+// Plan many independent orders, handing them out to 'thread_count' threads a chunk at a time
+std::vector<ProductionPlan> plan_orders(const OreCostSolver& solver,
+                                        const std::vector<std::vector<Demand>>& orders,
+                                        size_t thread_count)
 {
-    Surplus new_surplus;
+    constexpr size_t CHUNK_SIZE = 16;
 
-    const Reaction& production_reaction = reactions.at(product);
-    const uint64_t product_stock = surplus.count(product);
-    const uint64_t production_requirement = quantity > product_stock ? quantity - product_stock : 0;
+    std::vector<ProductionPlan> plans(orders.size());
+    std::atomic<size_t> next_order(0);
 
-    const uint64_t reaction_runs_required =
-        production_requirement == 0
-            ? 0
-            : (production_requirement + production_reaction.yield - 1) / production_reaction.yield;
+    auto worker = [&](void) {
+        while (true) {
+            const size_t begin = next_order.fetch_add(CHUNK_SIZE);
+            if (begin >= orders.size()) return;
+            const size_t end = std::min(begin + CHUNK_SIZE, orders.size());
+            for (size_t i = begin; i < end; i++) plans[i] = solver.plan(orders[i]);
+        }
+    };
 
-    const uint64_t new_surplus =
-        reaction_runs_required * production_reaction.yield - production_requirement;
+    std::vector<std::thread> threads;
+    for (size_t t = 1; t < thread_count; t++) threads.emplace_back(worker);
+    worker();
+    for (auto& t : threads) t.join();
 
-    new_surplus.assign(product, new_surplus);
+    return plans;
+}
+
+// Random reaction set of 'reaction_count' chemicals in puzzle format. Chemical i is made from
+// one to four chemicals with higher indices (or ORE), so the graph is a DAG with FUEL as
+// chemical 0 and heavily shared intermediates. Yields are large next to input counts, which
+// keeps requirements from growing exponentially with depth and overflowing.
+std::string generate_reactions(size_t reaction_count, uint32_t seed)
+{
+    std::mt19937 rng(seed);
+    auto name = [&](size_t i) { return i == 0 ? std::string("FUEL") : "C" + std::to_string(i); };
+
+    std::string text;
+    for (size_t i = 0; i < reaction_count; i++) {
+        const size_t input_count = 1 + rng() % 4;
+        for (size_t j = 0; j < input_count; j++) {
+            if (j > 0) text += ", ";
+            text += std::to_string(1 + rng() % 3) + " ";
+            // mostly nearby chemicals, so chains are long as well as shared
+            const size_t input = i + 1 + rng() % 8;
+            text += input < reaction_count && rng() % 5 != 0 ? name(input) : std::string("ORE");
+        }
+        text += " => " + std::to_string(5 + rng() % 10) + " " + name(i) + "\n";
+    }
+    return text;
+}
 
-    uint64_t ore_required = 0;
+void benchmark_solver(size_t reaction_count)
+{
+    ReactionGraph reactions;
+    const std::string text = generate_reactions(reaction_count, 1234);
+    parse_reactions(text, reactions);
+
+    auto start_time = std::chrono::steady_clock::now();
+    const OreCostSolver solver(reactions, *reactions.find("FUEL"));
+    auto end_time = std::chrono::steady_clock::now();
+    std::cout << solver.reaction_count() << " reactions, ordered in "
+              << std::chrono::duration_cast<std::chrono::microseconds>(end_time - start_time).count()
+              << "us" << std::endl;
+
+    constexpr int QUERY_COUNT = 1000;
+    uint64_t checksum = 0;
+    start_time = std::chrono::steady_clock::now();
+    for (int i = 1; i <= QUERY_COUNT; i++) checksum += solver.ore_cost(i);
+    end_time = std::chrono::steady_clock::now();
+    std::cout << QUERY_COUNT << " ore cost queries: "
+              << std::chrono::duration_cast<std::chrono::microseconds>(end_time - start_time).count() /
+                     QUERY_COUNT
+              << "us each (checksum " << checksum << ")" << std::endl;
+
+    start_time = std::chrono::steady_clock::now();
+    const uint64_t fuel = solver.max_product(1000000000000);
+    end_time = std::chrono::steady_clock::now();
+    std::cout << "max fuel for 1e12 ore: " << fuel << " in "
+              << std::chrono::duration_cast<std::chrono::microseconds>(end_time - start_time).count()
+              << "us" << std::endl;
+}
 
-    for (const auto& [iresource, icount] : production_reaction.inputs) {
-        const uint64_t input_requirement = reaction_runs_required * icount;
-        if (iresource == Chemical("ORE")) {
-            ore_required += input_requirement;
+void benchmark_planner(size_t order_count, size_t max_threads)
+{
+    ReactionGraph reactions;
+    const std::string text = generate_reactions(10000, 1234);
+    parse_reactions(text, reactions);
+
+    // every chemical with a reaction may be ordered
+    std::vector<Chemical> products;
+    for (uint32_t r = 0; r < reactions.reaction_count(); r++) products.push_back(reactions.output(r));
+    const OreCostSolver solver(reactions, products);
+
+    std::mt19937 rng(99);
+    std::vector<std::vector<Demand>> orders(order_count);
+    for (auto& order : orders) {
+        const size_t demand_count = 1 + rng() % 8;
+        for (size_t i = 0; i < demand_count; i++) {
+            order.emplace_back(products[rng() % products.size()], 1 + rng() % 1000);
+        }
+    }
+
+    std::vector<ProductionPlan> expected;
+    for (size_t threads = 1; threads <= max_threads; threads *= 2) {
+        const auto start_time = std::chrono::steady_clock::now();
+        std::vector<ProductionPlan> plans = plan_orders(solver, orders, threads);
+        const auto end_time = std::chrono::steady_clock::now();
+
+        uint64_t ore = 0;
+        uint64_t leftovers = 0;
+        for (const auto& plan : plans) {
+            ore += plan.ore;
+            leftovers += plan.leftovers.total();
+        }
+        std::cout << threads << " thread(s): " << order_count << " orders in "
+                  << std::chrono::duration_cast<std::chrono::milliseconds>(end_time - start_time).count()
+                  << "ms (" << ore << " ore, " << leftovers << " left over)" << std::endl;
+
+        if (expected.empty()) {
+            expected = std::move(plans);
         }
         else {
-            ore_required += compute_ore_cost(reactions, surplus, iresource, input_requirement);
+            for (size_t i = 0; i < plans.size(); i++) assert(plans[i].ore == expected[i].ore);
         }
     }
+}
 
-    return ore_required;
+// apply random single-number edits to a generated reaction graph, timing incremental updates
+// against solving from scratch after every edit, and checking they agree
+void benchmark_incremental(size_t edit_count)
+{
+    ReactionGraph reactions;
+    const std::string text = generate_reactions(10000, 1234);
+    parse_reactions(text, reactions);
+    const Chemical fuel = *reactions.find("FUEL");
+    constexpr uint64_t ORE_BUDGET = 1000000000000;
+
+    IncrementalSolver incremental(reactions, fuel, ORE_BUDGET);
+    const size_t initial_searches = incremental.full_searches();
+    const size_t initial_visits = incremental.steps_visited();
+
+    std::mt19937 rng(7);
+    struct Edit {
+        Chemical output;
+        std::optional<uint32_t> input_index;  // empty for a yield change
+        uint64_t value;
+    };
+    std::vector<Edit> edits;
+    OreCostSolver reference(reactions, fuel);
+    while (edits.size() < edit_count) {
+        const uint32_t r = rng() % reactions.reaction_count();
+        const Chemical output = reactions.output(r);
+        if (!reference.contains(output)) continue;  // FUEL doesn't depend on it
+
+        if (rng() % 2 == 0) {
+            edits.push_back({output, {}, 5 + rng() % 10});
+        }
+        else {
+            const uint32_t input_count = reactions.inputs_end(r) - reactions.inputs_begin(r);
+            edits.push_back({output, uint32_t(rng() % input_count), 1 + rng() % 3});
+        }
+    }
+
+    auto apply = [](auto& target, const Edit& edit) {
+        if (edit.input_index) {
+            target.set_input_count(edit.output, *edit.input_index, edit.value);
+        }
+        else {
+            target.set_yield(edit.output, edit.value);
+        }
+    };
+
+    // answers after every edit, to check against the full re-solves below
+    std::vector<std::pair<uint64_t, uint64_t>> answers;
+    answers.reserve(edits.size());
+
+    auto start_time = std::chrono::steady_clock::now();
+    for (const Edit& edit : edits) {
+        apply(incremental, edit);
+        answers.emplace_back(incremental.ore_cost(), incremental.max_product());
+    }
+    auto end_time = std::chrono::steady_clock::now();
+    std::cout << edit_count << " incremental edits: "
+              << std::chrono::duration_cast<std::chrono::microseconds>(end_time - start_time).count()
+              << "us, " << incremental.steps_visited() - initial_visits << " steps visited, "
+              << incremental.full_searches() - initial_searches << " max fuel re-searches" << std::endl;
+
+    uint64_t checksum = 0;
+    start_time = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < edits.size(); i++) {
+        apply(reference, edits[i]);
+        const uint64_t ore = reference.ore_cost(1);
+        const uint64_t fuel = reference.max_product(ORE_BUDGET);
+        if (answers[i] != std::make_pair(ore, fuel)) {
+            std::cerr << "incremental answer mismatch after edit " << i << std::endl;
+            exit(EXIT_FAILURE);
+        }
+        checksum += ore + fuel;
+    }
+    end_time = std::chrono::steady_clock::now();
+    std::cout << edit_count << " full re-solves: "
+              << std::chrono::duration_cast<std::chrono::microseconds>(end_time - start_time).count()
+              << "us (checksum " << checksum << ")" << std::endl;
+
+    std::cout << "final ore cost " << incremental.ore_cost() << ", max fuel " << incremental.max_product()
+              << std::endl;
+}
+
+// generate a reaction file of about 'megabytes' MB and time reading it back
+void benchmark_parser(size_t megabytes)
+{
+    const char* filepath = "14_parse_bench.txt";
+
+    // generated lines average a little under 40 bytes
+    const std::string text = generate_reactions(megabytes * 1000000 / 38, 1234);
+    {
+        std::ofstream outfile(filepath, std::ios::binary);
+        outfile << text;
+    }
+
+    // the first read warms the page cache, the second is timed
+    for (int run = 0; run < 2; run++) {
+        ReactionGraph reactions;
+        const auto start_time = std::chrono::steady_clock::now();
+        read_reactions(filepath, reactions);
+        const auto end_time = std::chrono::steady_clock::now();
+
+        if (run == 1) {
+            const auto us = std::chrono::duration_cast<std::chrono::microseconds>(end_time - start_time).count();
+            std::cout << text.size() << " bytes, " << reactions.reaction_count() << " reactions in " << us
+                      << "us (" << double(text.size()) / std::max<int64_t>(us, 1) << " MB/s)" << std::endl;
+        }
+    }
+
+    std::remove(filepath);
 }
 
-void solve_part_one(const ReactionSet& reactions)
+void solve_part_one(const ReactionGraph& reactions)
 {
-    Surplus surplus;
-    const auto answer = compute_ore_cost(reactions, surplus, Chemical("FUEL"), 1);
+    const Chemical fuel = *reactions.find("FUEL");
+    const OreCostSolver solver(reactions, fuel);
+    const auto answer = solver.ore_cost(1);
+    assert(solver.plan({{fuel, 1}}).ore == answer);
+
+    // stocked ORE is used up first, and whatever isn't needed is left over; ORE can be
+    // demanded directly too
+    const Chemical ore = *reactions.find("ORE");
+    Surplus stock;
+    stock.assign(ore, answer + 7);
+    const ProductionPlan stocked = solver.plan({{fuel, 1}}, stock);
+    assert(stocked.ore == 0 && stocked.leftovers.count(ore) == 7);
+    const ProductionPlan with_ore = solver.plan({{fuel, 1}, {ore, 10}}, stock);
+    assert(with_ore.ore == 3 && with_ore.leftovers.count(ore) == 0);
     std::cout << "part one answer =  " << answer << std::endl;
 }
 
-int main(void)
+void solve_part_two(const ReactionGraph& reactions)
 {
-    ska::flat_hash_map<Chemical, Reaction> reactions;
-
-    std::cout << "Reading input reactions..." << std::endl;
-    for_each_line_in_file("../inputs/14.txt", [&](std::string_view line) {
-        std::cout << line << std::endl;
-        const auto [in_str, out_elem_str] = split(line, "=>");
-        const auto in_elem_strs = split_on(in_str, ",");
-
-        auto convert_elem_str = [](std::string_view elem_str) -> ReactionElement {
-            const auto [count_str, resource_str] = split(elem_str, " ");
-            assert(!count_str.empty() || !elem_str.empty());
-            return ReactionElement(resource_str, *convert_string<uint64_t>(count_str));
-        };
+    const OreCostSolver solver(reactions, *reactions.find("FUEL"));
+    const auto answer = solver.max_product(1000000000000);
+    std::cout << "part two answer =  " << answer << std::endl;
+}
 
-        ReactionElement output = convert_elem_str(out_elem_str);
+// usage: 14 [--verbose] [--bench [reaction count]] [--plan-bench [order count] [max threads]]
+//           [--edit-bench [edit count]] [--parse-bench [megabytes]]
+int main(int argc, char** argv)
+{
+    const bool verbose = argc > 1 && std::string(argv[1]) == "--verbose";
+    if (verbose) {
+        argc--;
+        argv++;
+    }
 
-        // read the reaction inputs
-        std::vector<ReactionElement> inputs;
-        inputs.reserve(in_elem_strs.size());
-        for (auto elem_str : in_elem_strs) {
-            inputs.emplace_back(convert_elem_str(elem_str));
-        }
+    if (argc > 1 && std::string(argv[1]) == "--parse-bench") {
+        benchmark_parser(argc > 2 ? std::stoull(argv[2]) : 50);
+        return 0;
+    }
+    if (argc > 1 && std::string(argv[1]) == "--bench") {
+        benchmark_solver(argc > 2 ? std::stoull(argv[2]) : 10000);
+        return 0;
+    }
+    if (argc > 1 && std::string(argv[1]) == "--edit-bench") {
+        benchmark_incremental(argc > 2 ? std::stoull(argv[2]) : 500);
+        return 0;
+    }
+    if (argc > 1 && std::string(argv[1]) == "--plan-bench") {
+        benchmark_planner(argc > 2 ? std::stoull(argv[2]) : 4000, argc > 3 ? std::stoull(argv[3]) : 8);
+        return 0;
+    }
+
+    ReactionGraph reactions;
 
-        reactions.emplace(output.resource, Reaction{std::move(inputs), output.count});
-    });
-    std::cout << "... finished reading input reactions." << std::endl;
+    if (verbose) std::cout << "Reading input reactions..." << std::endl;
+    read_reactions("../inputs/14.txt", reactions, verbose);
+    if (verbose) std::cout << "... finished reading input reactions." << std::endl;
 
     solve_part_one(reactions);
+    solve_part_two(reactions);
 
     return 0;
 }
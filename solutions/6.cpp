@@ -1,182 +1,735 @@
 #include <assert.h>
 
-#include <fstream>
-#include <functional>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstring>
 #include <iostream>
-#include <map>
-#include <memory>
+#include <limits>
+#include <optional>
+#include <random>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 
-struct OrbitTree {
-    size_t m_id;
-    std::vector<std::unique_ptr<OrbitTree>> m_children;
-    OrbitTree* m_parent;
+#include "mapped_file.hpp"
 
-    static std::map<size_t, std::string> names;
+// Interns body names to dense ids. The bytes of every name are copied once into a single
+// arena, and lookups go through an open addressing table. Names of up to eight bytes (all of
+// the puzzle's) are packed into the slot itself and compared exactly without touching the
+// arena; longer names are keyed by a hash which is always confirmed against the stored bytes,
+// so colliding names still get distinct ids.
+class NameTable {
+public:
+    using Id = uint32_t;
+    static constexpr Id NO_ID = std::numeric_limits<Id>::max();
+
+private:
+    struct Slot {
+        uint64_t key;  // packed name bytes if length <= 8, otherwise a hash of the name
+        Id id;
+        uint32_t length;
+    };
 
-    OrbitTree(size_t _id, OrbitTree* _parent) : m_id(_id), m_parent(_parent) {}
+    std::vector<char> m_arena;
+    std::vector<uint32_t> m_offsets;  // name 'i' is m_arena[m_offsets[i] .. m_offsets[i + 1])
+    std::vector<Slot> m_slots;        // power of two sized, at most half full
 
-    void count_orbits_helper(size_t current_depth, size_t& indirect_count, size_t& direct_count)
+    static uint64_t make_key(std::string_view name)
     {
-        direct_count += m_children.size();
+        uint64_t key = 0;
+        if (name.size() <= 8) {
+            for (size_t i = 0; i < name.size(); i++) key |= uint64_t(uint8_t(name[i])) << (8 * i);
+            return key;
+        }
 
-        if (current_depth > 1) {
-            indirect_count += current_depth - 1;
+        // word at a time multiplicative hash
+        key = 0x9e3779b97f4a7c15ULL;
+        size_t i = 0;
+        for (; i + 8 <= name.size(); i += 8) {
+            uint64_t word;
+            std::memcpy(&word, name.data() + i, 8);
+            key = (key ^ word) * 0xff51afd7ed558ccdULL;
         }
+        uint64_t tail = 0;
+        std::memcpy(&tail, name.data() + i, name.size() - i);
+        return (key ^ tail) * 0xc4ceb9fe1a85ec53ULL;
+    }
+
+    static size_t home_slot(uint64_t key, uint32_t length, size_t mask)
+    {
+        uint64_t h = (key ^ length) * 0x9e3779b97f4a7c15ULL;
+        return (h ^ (h >> 32)) & mask;
+    }
+
+    bool matches(const Slot& slot, uint64_t key, std::string_view name) const
+    {
+        if (slot.key != key || slot.length != name.size()) return false;
+        return name.size() <= 8 || this->name(slot.id) == name;
+    }
 
-        for (auto& child : m_children) {
-            child->count_orbits_helper(current_depth + 1, indirect_count, direct_count);
+    size_t find_slot(uint64_t key, std::string_view name) const
+    {
+        const size_t mask = m_slots.size() - 1;
+        for (size_t i = home_slot(key, name.size(), mask);; i = (i + 1) & mask) {
+            if (m_slots[i].id == NO_ID || matches(m_slots[i], key, name)) return i;
         }
-    };
+    }
 
-    std::optional<size_t> distance_to(size_t end_id, std::optional<size_t> ignore_child_node,
-                                      size_t distance_so_far, bool try_parent)
+    void rehash(size_t slot_count)
     {
-        if (m_id == end_id) {
-            return distance_so_far;
+        std::vector<Slot> old(slot_count, Slot{0, NO_ID, 0});
+        old.swap(m_slots);
+
+        const size_t mask = m_slots.size() - 1;
+        for (const Slot& slot : old) {
+            if (slot.id == NO_ID) continue;
+            size_t i = home_slot(slot.key, slot.length, mask);
+            while (m_slots[i].id != NO_ID) i = (i + 1) & mask;
+            m_slots[i] = slot;
         }
+    }
 
-        for (auto& child : m_children) {
-            if (ignore_child_node && child->m_id == *ignore_child_node) {
-                continue;
-            }
-            auto d = child->distance_to(end_id, {}, distance_so_far + 1, false);
-            if (d) {
-                return d;
-            }
+public:
+    NameTable(void) : m_offsets{0}, m_slots(64, Slot{0, NO_ID, 0}) {}
+
+    void reserve(size_t name_count, size_t total_bytes)
+    {
+        m_arena.reserve(total_bytes);
+        m_offsets.reserve(name_count + 1);
+        size_t slot_count = m_slots.size();
+        while (slot_count < 2 * name_count) slot_count *= 2;
+        if (slot_count != m_slots.size()) rehash(slot_count);
+    }
+
+    size_t size(void) const { return m_offsets.size() - 1; }
+
+    std::string_view name(Id id) const
+    {
+        return {m_arena.data() + m_offsets[id], m_offsets[id + 1] - m_offsets[id]};
+    }
+
+    // returns the id of 'name', and whether it was newly added
+    std::pair<Id, bool> intern(std::string_view name)
+    {
+        const uint64_t key = make_key(name);
+        size_t i = find_slot(key, name);
+        if (m_slots[i].id != NO_ID) return {m_slots[i].id, false};
+
+        if (2 * (size() + 1) > m_slots.size()) {
+            rehash(m_slots.size() * 2);
+            i = find_slot(key, name);
+        }
+
+        const Id id = Id(size());
+        m_arena.insert(m_arena.end(), name.begin(), name.end());
+        m_offsets.push_back(uint32_t(m_arena.size()));
+        m_slots[i] = {key, id, uint32_t(name.size())};
+        return {id, true};
+    }
+
+    Id find(std::string_view name) const { return m_slots[find_slot(make_key(name), name)].id; }
+
+    // Pull the slot 'name' hashes to into cache ahead of an intern(). Issuing these for a
+    // batch of names first lets their cache misses overlap instead of being paid one by one.
+    void prefetch(std::string_view name) const
+    {
+        const size_t i = home_slot(make_key(name), name.size(), m_slots.size() - 1);
+        __builtin_prefetch(&m_slots[i]);
+    }
+};
+
+// sum of an array of body depths
+static uint64_t sum_depths(const uint32_t* depths, size_t n)
+{
+    size_t i = 0;
+    uint64_t total = 0;
+#ifdef __SSE2__
+    // widen four depths at a time into 64 bit lanes; millions of bodies at depths in the
+    // thousands would overflow 32 bit accumulators
+    const __m128i zero = _mm_setzero_si128();
+    __m128i acc_low = zero;
+    __m128i acc_high = zero;
+    for (; i + 4 <= n; i += 4) {
+        const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(depths + i));
+        acc_low = _mm_add_epi64(acc_low, _mm_unpacklo_epi32(v, zero));
+        acc_high = _mm_add_epi64(acc_high, _mm_unpackhi_epi32(v, zero));
+    }
+    alignas(16) uint64_t lanes[2];
+    _mm_store_si128(reinterpret_cast<__m128i*>(lanes), _mm_add_epi64(acc_low, acc_high));
+    total = lanes[0] + lanes[1];
+#endif
+    for (; i < n; i++) total += depths[i];
+    return total;
+}
+
+// Flat representation of the orbit forest. Bodies are interned to dense integer ids as the
+// input is read, each body's center is stored in a parent array indexed by id, and the
+// satellites of every body are laid out contiguously in CSR (compressed sparse row) form.
+// Construction is O(n): every edge is touched a constant number of times.
+class OrbitIndex {
+public:
+    using Id = NameTable::Id;
+    static constexpr Id NO_PARENT = std::numeric_limits<Id>::max();
+
+private:
+    NameTable m_names;
+
+    std::vector<Id> m_parent;
+
+    // satellites of body 'i' are m_children[m_child_offsets[i] .. m_child_offsets[i + 1])
+    std::vector<Id> m_child_offsets;
+    std::vector<Id> m_children;
+
+    // breadth first order of the forest (every body after its center) and each body's depth,
+    // both filled in by finalize()
+    std::vector<Id> m_order;
+    std::vector<uint32_t> m_depth;
+
+    size_t m_orbit_count;
+
+public:
+    OrbitIndex(void) : m_orbit_count(0) {}
+
+    // size the tables up front for an input of 'orbit_count' lines and 'byte_count' bytes
+    void reserve(size_t orbit_count, size_t byte_count)
+    {
+        m_names.reserve(orbit_count + 1, byte_count);
+        m_parent.reserve(orbit_count + 1);
+    }
+
+    Id intern(std::string_view name)
+    {
+        const auto [id, inserted] = m_names.intern(name);
+        if (inserted) m_parent.push_back(NO_PARENT);
+        return id;
+    }
+
+    std::optional<Id> find(std::string_view name) const
+    {
+        const Id id = m_names.find(name);
+        if (id == NameTable::NO_ID) return {};
+        return id;
+    }
+
+    void prefetch(std::string_view name) const { m_names.prefetch(name); }
+
+    // record that 'satellite' directly orbits 'center'
+    void add_orbit(std::string_view center, std::string_view satellite)
+    {
+        const Id c = intern(center);
+        const Id s = intern(satellite);
+        assert(c != s);
+        assert(m_parent[s] == NO_PARENT);  // every body orbits at most one other body
+
+        m_parent[s] = c;
+        m_orbit_count++;
+    }
+
+    // build the CSR child lists from the parent array, by counting sort on the parent id
+    void finalize(void)
+    {
+        const size_t n = m_parent.size();
+
+        m_child_offsets.assign(n + 1, 0);
+        for (Id p : m_parent) {
+            if (p != NO_PARENT) m_child_offsets[p + 1]++;
+        }
+        for (size_t i = 0; i < n; i++) {
+            m_child_offsets[i + 1] += m_child_offsets[i];
         }
 
-        if (try_parent && m_parent) {
-            return m_parent->distance_to(end_id, m_id, distance_so_far + 1, true);
+        m_children.resize(m_child_offsets[n]);
+        std::vector<Id> fill_position(m_child_offsets.begin(), m_child_offsets.end() - 1);
+        for (Id i = 0; i < n; i++) {
+            if (m_parent[i] != NO_PARENT) m_children[fill_position[m_parent[i]]++] = i;
         }
-        else {
-            return {};
+
+        // one pass over the forest in topological order: a body's depth is always known by
+        // the time its satellites are reached, so no recursion or explicit stack is needed
+        m_order.clear();
+        m_order.reserve(n);
+        m_depth.assign(n, 0);
+        for (Id id = 0; id < n; id++) {
+            if (m_parent[id] == NO_PARENT) m_order.push_back(id);
+        }
+        for (size_t i = 0; i < m_order.size(); i++) {
+            const Id id = m_order[i];
+            const uint32_t child_depth = m_depth[id] + 1;
+            for (Id c = m_child_offsets[id]; c < m_child_offsets[id + 1]; c++) {
+                m_depth[m_children[c]] = child_depth;
+                m_order.push_back(m_children[c]);
+            }
         }
+        assert(m_order.size() == n);  // anything unreached would be part of a cycle
     }
 
-    OrbitTree* get_com_node(void)
+    size_t size(void) const { return m_parent.size(); }
+    Id parent(Id id) const { return m_parent[id]; }
+    std::string_view name(Id id) const { return m_names.name(id); }
+    uint32_t depth(Id id) const { return m_depth[id]; }
+    const std::vector<Id>& topological_order(void) const { return m_order; }
+
+    std::pair<const Id*, const Id*> children(Id id) const
     {
-        OrbitTree* node = this;
-        while (node->m_parent) {
-            node = node->m_parent;
-        };
-        return node;
-    };
+        return {m_children.data() + m_child_offsets[id], m_children.data() + m_child_offsets[id + 1]};
+    }
+
+    // {direct, indirect} orbit counts: every body at depth d contributes one direct orbit
+    // and d - 1 indirect orbits, so the total is just the sum of the depth array.
+    std::pair<size_t, size_t> count_orbits(void) const
+    {
+        const uint64_t total = sum_depths(m_depth.data(), m_depth.size());
+        return {m_orbit_count, total - m_orbit_count};
+    }
 
-    OrbitTree* find_node_helper(size_t find_id)
+    // number of orbital transfers between two bodies, i.e. edges on the path between them
+    std::optional<size_t> distance_between(Id start, Id end) const
     {
-        if (m_id == find_id) {
-            return this;
+        // distance from 'start' to each of its ancestors, indexed by ancestor id
+        std::unordered_map<Id, size_t> start_ancestors;
+        size_t d = 0;
+        for (Id id = start; id != NO_PARENT; id = m_parent[id]) start_ancestors[id] = d++;
+
+        d = 0;
+        for (Id id = end; id != NO_PARENT; id = m_parent[id], d++) {
+            auto it = start_ancestors.find(id);
+            if (it != start_ancestors.end()) return it->second + d;
         }
-        else {
-            for (auto& child : m_children) {
-                OrbitTree* ptr = child->find_node_helper(find_id);
-                if (ptr) return ptr;
-            }
+
+        return {};  // different trees
+    }
+};
+
+// Answers body-to-body transfer distance queries in O(log n) with binary lifting: for every
+// body we store its 2^k-th ancestor for each k up to the height of the tallest tree, so the
+// lowest common ancestor of two bodies can be found by jumping both up in power-of-two steps.
+class OrbitDistanceOracle {
+public:
+    using Id = OrbitIndex::Id;
+    static constexpr uint32_t NO_DISTANCE = std::numeric_limits<uint32_t>::max();
+
+private:
+    std::vector<uint32_t> m_depth;
+    // m_ancestors[k][id] is the 2^k-th ancestor of 'id', or the root of its tree if the tree
+    // isn't that tall
+    std::vector<std::vector<Id>> m_ancestors;
+
+    Id lift(Id id, uint32_t distance) const
+    {
+        for (size_t k = 0; distance != 0; k++, distance >>= 1) {
+            if (distance & 1) id = m_ancestors[k][id];
+        }
+        return id;
+    }
+
+public:
+    OrbitDistanceOracle(const OrbitIndex& orbits) : m_depth(orbits.size())
+    {
+        const size_t n = orbits.size();
+
+        uint32_t max_depth = 0;
+        for (Id id = 0; id < n; id++) {
+            m_depth[id] = orbits.depth(id);
+            max_depth = std::max(max_depth, m_depth[id]);
+        }
+
+        std::vector<Id> parents(n);
+        for (Id id = 0; id < n; id++) {
+            const Id p = orbits.parent(id);
+            parents[id] = p == OrbitIndex::NO_PARENT ? id : p;
+        }
+        m_ancestors.push_back(std::move(parents));
+
+        for (uint64_t span = 2; span <= max_depth; span *= 2) {
+            const std::vector<Id>& half = m_ancestors.back();
+            std::vector<Id> next(n);
+            for (Id id = 0; id < n; id++) next[id] = half[half[id]];
+            m_ancestors.push_back(std::move(next));
         }
-        return nullptr;
     }
 
-    OrbitTree* find_node(size_t find_id) { return get_com_node()->find_node_helper(find_id); }
+    uint32_t depth(Id id) const { return m_depth[id]; }
 
-    bool insert_helper(size_t parent_id, size_t child_id)
+    // NO_DISTANCE if the two bodies aren't in the same tree
+    uint32_t distance(Id a, Id b) const
     {
-        if (m_id == parent_id) {
-            m_children.emplace_back(std::make_unique<OrbitTree>(child_id, this));
-            return true;
+        const uint32_t depth_a = m_depth[a];
+        const uint32_t depth_b = m_depth[b];
+
+        if (depth_a > depth_b) {
+            a = lift(a, depth_a - depth_b);
         }
         else {
-            for (auto& child : m_children) {
-                if (child->insert_helper(parent_id, child_id)) {
-                    return true;
+            b = lift(b, depth_b - depth_a);
+        }
+
+        if (a != b) {
+            for (size_t k = m_ancestors.size(); k-- > 0;) {
+                if (m_ancestors[k][a] != m_ancestors[k][b]) {
+                    a = m_ancestors[k][a];
+                    b = m_ancestors[k][b];
                 }
             }
+            a = m_ancestors[0][a];
+            b = m_ancestors[0][b];
+            if (a != b) return NO_DISTANCE;
         }
 
-        return false;
+        return depth_a + depth_b - 2 * m_depth[a];
     }
 
-public:
-    OrbitTree(size_t com_id) : m_id(com_id), m_parent(nullptr) {}
-
-    void insert(size_t parent_id, size_t child_id)
+    // Answer many queries at once, split into contiguous ranges over 'thread_count' threads.
+    // The tables are read only, so the threads share nothing but the output array.
+    std::vector<uint32_t> distances(const std::vector<std::pair<Id, Id>>& queries,
+                                    size_t thread_count) const
     {
-        assert(parent_id != child_id);
-        bool was_inserted = get_com_node()->insert_helper(parent_id, child_id);
-        assert(was_inserted);
+        std::vector<uint32_t> results(queries.size());
+        thread_count = std::max<size_t>(1, std::min(thread_count, queries.size()));
+
+        auto answer_range = [&](size_t begin, size_t end) {
+            for (size_t i = begin; i < end; i++) {
+                results[i] = distance(queries[i].first, queries[i].second);
+            }
+        };
+
+        std::vector<std::thread> threads;
+        const size_t per_thread = (queries.size() + thread_count - 1) / thread_count;
+        for (size_t t = 1; t < thread_count; t++) {
+            threads.emplace_back(answer_range, std::min(t * per_thread, queries.size()),
+                                 std::min((t + 1) * per_thread, queries.size()));
+        }
+        answer_range(0, std::min(per_thread, queries.size()));
+        for (auto& t : threads) t.join();
+
+        return results;
     }
+};
 
-    std::pair<size_t, size_t> count_orbits(void)
-    {
-        size_t indirect = 0;
-        size_t direct = 0;
-        get_com_node()->count_orbits_helper(0, indirect, direct);
+// Run fn(t, begin, end) over at most 'thread_count' contiguous ranges of [0, n), one per
+// thread, where t is the range's index. Returns the number of ranges used; only the last
+// may be shorter than the rest, and none is empty unless n is 0 (a single call fn(0, 0, 0)).
+template <typename Fn>
+size_t parallel_for_ranges(size_t n, size_t thread_count, const Fn& fn)
+{
+    thread_count = std::max<size_t>(1, std::min(thread_count, n));
+    const size_t per_thread = std::max<size_t>(1, (n + thread_count - 1) / thread_count);
+    // rounding per_thread up can leave trailing threads nothing to do, so don't start them
+    const size_t range_count = std::max<size_t>(1, (n + per_thread - 1) / per_thread);
+
+    std::vector<std::thread> threads;
+    for (size_t t = 1; t < range_count; t++) {
+        threads.emplace_back(fn, t, t * per_thread, std::min((t + 1) * per_thread, n));
+    }
+    fn(0, 0, std::min(per_thread, n));
+    for (auto& t : threads) t.join();
+
+    return range_count;
+}
+
+// Depth of every body by pointer jumping over the parent array, with no traversal order at
+// all. Each body tracks some ancestor and its distance to it; every round replaces that
+// ancestor with the ancestor's own ancestor and adds the two distances, so after
+// ceil(log2(height)) rounds every body points at its root and holds its depth. Bodies are
+// independent within a round, so each round is split evenly across the threads.
+std::vector<uint32_t> parallel_orbit_depths(const OrbitIndex& orbits, size_t thread_count)
+{
+    using Id = OrbitIndex::Id;
+    const size_t n = orbits.size();
+
+    std::vector<Id> ancestor(n);
+    std::vector<uint32_t> depth(n);
+    parallel_for_ranges(n, thread_count, [&](size_t, size_t begin, size_t end) {
+        for (size_t i = begin; i < end; i++) {
+            const Id p = orbits.parent(Id(i));
+            ancestor[i] = p == OrbitIndex::NO_PARENT ? Id(i) : p;
+            depth[i] = p == OrbitIndex::NO_PARENT ? 0 : 1;
+        }
+    });
+
+    // rounds read one pair of arrays and write the other, so no thread sees a half updated
+    // neighbour
+    std::vector<Id> next_ancestor(n);
+    std::vector<uint32_t> next_depth(n);
+    std::atomic<bool> changed(true);
+
+    while (changed) {
+        changed = false;
+        parallel_for_ranges(n, thread_count, [&](size_t, size_t begin, size_t end) {
+            bool local_changed = false;
+            for (size_t i = begin; i < end; i++) {
+                const Id a = ancestor[i];
+                next_ancestor[i] = ancestor[a];
+                next_depth[i] = depth[i] + depth[a];
+                local_changed |= ancestor[a] != a;
+            }
+            if (local_changed) changed = true;
+        });
+        ancestor.swap(next_ancestor);
+        depth.swap(next_depth);
+    }
 
-        return {direct, indirect};
+    return depth;
+}
+
+// {direct, indirect} orbit counts from parallel_orbit_depths(), summed in parallel too
+std::pair<size_t, size_t> parallel_count_orbits(const OrbitIndex& orbits, size_t thread_count)
+{
+    const std::vector<uint32_t> depths = parallel_orbit_depths(orbits, thread_count);
+
+    thread_count = std::max<size_t>(1, thread_count);
+    std::vector<uint64_t> partial_totals(thread_count, 0);
+    std::vector<uint64_t> partial_direct(thread_count, 0);
+
+    auto sum_range = [&](size_t t, size_t begin, size_t end) {
+        partial_totals[t] = sum_depths(depths.data() + begin, end - begin);
+        partial_direct[t] = std::count_if(depths.begin() + begin, depths.begin() + end,
+                                          [](uint32_t d) { return d != 0; });
     };
+    const size_t range_count = parallel_for_ranges(depths.size(), thread_count, sum_range);
 
-    std::optional<size_t> distance_between(size_t start_id, size_t end_id)
-    {
-        OrbitTree* start_node = this->find_node(start_id);
-        if (start_node == nullptr) return {};
+    uint64_t total = 0;
+    uint64_t direct = 0;
+    for (size_t t = 0; t < range_count; t++) {
+        total += partial_totals[t];
+        direct += partial_direct[t];
+    }
+    return {direct, total - direct};
+}
+
+// Parse an orbit map of "CENTER)SATELLITE" lines in place. Names are views into 'text' until
+// they're interned, so the only allocations are the amortized growth of the index's arrays.
+static void parse_orbit_map(std::string_view text, OrbitIndex& orbits)
+{
+    // puzzle lines are "AAA)BBB\n"; overestimating a little is cheaper than growing
+    orbits.reserve(text.size() / 8 + 1, text.size());
+
+    // Lines are tokenized a batch at a time and every name's table slot prefetched before any
+    // of them are interned, since on a large map nearly every lookup is a cache miss.
+    constexpr size_t BATCH_SIZE = 32;
+    std::string_view centers[BATCH_SIZE];
+    std::string_view satellites[BATCH_SIZE];
+
+    const char* p = text.data();
+    const char* const end = p + text.size();
+    while (p < end) {
+        size_t batch_count = 0;
+        while (p < end && batch_count < BATCH_SIZE) {
+            // names are a handful of bytes, so a plain scan beats calling memchr twice a line
+            const char* paren = p;
+            while (paren < end && *paren != ')' && *paren != '\n') paren++;
+            const char* line_end = paren;
+            while (line_end < end && *line_end != '\n') line_end++;
+
+            if (paren < line_end) {
+                const char* satellite_end = line_end;
+                if (satellite_end > paren + 1 && satellite_end[-1] == '\r') satellite_end--;
+                centers[batch_count] = std::string_view(p, paren - p);
+                satellites[batch_count] = std::string_view(paren + 1, satellite_end - paren - 1);
+                orbits.prefetch(centers[batch_count]);
+                orbits.prefetch(satellites[batch_count]);
+                batch_count++;
+            }
 
-        return start_node->distance_to(end_id, {}, 0, true);
+            p = line_end + 1;
+        }
+
+        for (size_t i = 0; i < batch_count; i++) orbits.add_orbit(centers[i], satellites[i]);
     }
-};
+}
 
-std::map<size_t, std::string> OrbitTree::names = std::map<size_t, std::string>();
+static void parse_orbit_map(const char* filepath, OrbitIndex& orbits)
+{
+    const MappedFile file(filepath);
+    parse_orbit_map(file.contents(), orbits);
+}
 
-int main(void)
+// time 'count' random distance queries against the puzzle input for increasing thread counts
+void benchmark_distance_queries(const OrbitIndex& orbits, size_t count)
 {
-    std::ifstream infile("../inputs/6.txt");
-    std::string orbit_str;
+    const OrbitDistanceOracle oracle(orbits);
 
-    std::multimap<size_t, size_t> orbit_map;
-    std::map<size_t, std::string> planet_hash_name_map;
-    size_t com_hash, you_orbiting_hash, santa_orbiting_hash;
+    std::mt19937 rng(12345);
+    std::uniform_int_distribution<OrbitIndex::Id> random_body(0, orbits.size() - 1);
 
-    while (std::getline(infile, orbit_str)) {
-        const size_t paren_pos = orbit_str.find(")");
-        const std::string o1 = orbit_str.substr(0, paren_pos);
-        const std::string o2 = orbit_str.substr(paren_pos + 1, orbit_str.size());
+    std::vector<std::pair<OrbitIndex::Id, OrbitIndex::Id>> queries(count);
+    for (auto& q : queries) q = {random_body(rng), random_body(rng)};
 
-        const size_t o1_hash = std::hash<std::string>{}(o1);
-        const size_t o2_hash = std::hash<std::string>{}(o2);
+    const size_t max_threads = std::max(1u, std::thread::hardware_concurrency());
+    for (size_t threads = 1; threads <= max_threads; threads *= 2) {
+        const auto start_time = std::chrono::steady_clock::now();
+        const auto results = oracle.distances(queries, threads);
+        const auto end_time = std::chrono::steady_clock::now();
 
-        OrbitTree::names[o1_hash] = o1;
-        OrbitTree::names[o2_hash] = o2;
+        uint64_t checksum = 0;
+        for (uint32_t d : results) checksum += d;
 
-        if (o1 == "COM") com_hash = o1_hash;
-        if (o2 == "YOU") you_orbiting_hash = o1_hash;
-        if (o2 == "SAN") santa_orbiting_hash = o1_hash;
+        std::cout << threads << " thread(s): " << count << " queries in "
+                  << std::chrono::duration_cast<std::chrono::milliseconds>(end_time - start_time).count()
+                  << "ms (checksum " << checksum << ")" << std::endl;
+    }
+}
 
-        orbit_map.emplace(o1_hash, o2_hash);
+// time parsing (and finalizing) an orbit map file that's already in the page cache and
+// mapped, reporting the best of a few runs
+void benchmark_parse(const char* filepath)
+{
+    const MappedFile file(filepath);
+    const std::string_view text = file.contents();
+
+    int64_t best_parse_us = std::numeric_limits<int64_t>::max();
+    int64_t best_finalize_us = std::numeric_limits<int64_t>::max();
+    size_t body_count = 0;
+
+    for (int run = 0; run < 5; run++) {
+        OrbitIndex orbits;
+
+        const auto start_time = std::chrono::steady_clock::now();
+        parse_orbit_map(text, orbits);
+        const auto parsed_time = std::chrono::steady_clock::now();
+        orbits.finalize();
+        const auto end_time = std::chrono::steady_clock::now();
+
+        best_parse_us = std::min<int64_t>(
+            best_parse_us,
+            std::chrono::duration_cast<std::chrono::microseconds>(parsed_time - start_time).count());
+        best_finalize_us = std::min<int64_t>(
+            best_finalize_us,
+            std::chrono::duration_cast<std::chrono::microseconds>(end_time - parsed_time).count());
+        body_count = orbits.size();
     }
 
-    OrbitTree tree(com_hash);
+    std::cout << filepath << ": " << body_count << " bodies, " << text.size() << " bytes" << std::endl;
+    std::cout << "parse: " << best_parse_us << "us ("
+              << double(text.size()) / std::max<int64_t>(best_parse_us, 1) << " MB/s)" << std::endl;
+    std::cout << "finalize: " << best_finalize_us << "us" << std::endl;
+}
 
-    std::function<void(size_t)> fill_tree;
+// Random orbit map of 'body_count' bodies in puzzle format, named by their index in base 36.
+// Every body orbits one of the 'spread' bodies created just before it, so a small spread gives
+// long chains (height ~ 2n / (spread + 1)) and a spread of n a wide tree of logarithmic height.
+std::string generate_orbit_map(size_t body_count, size_t spread, uint32_t seed)
+{
+    auto body_name = [](size_t i) {
+        std::string name;
+        do {
+            name.push_back("0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZ"[i % 36]);
+            i /= 36;
+        } while (i != 0);
+        return name;
+    };
+
+    std::mt19937 rng(seed);
+    std::string text;
+    text.reserve(body_count * 10);
+    for (size_t i = 1; i < body_count; i++) {
+        const size_t window = std::min(spread, i);
+        const size_t center = i - 1 - rng() % window;
+        text += body_name(center);
+        text += ')';
+        text += body_name(i);
+        text += '\n';
+    }
+    return text;
+}
 
-    fill_tree = [&](size_t parent_id) {
-        auto child_itr = orbit_map.equal_range(parent_id);
-        for (auto it = child_itr.first; it != child_itr.second; it++) {
-            assert(parent_id == it->first);
-            tree.insert(parent_id, it->second);
-            fill_tree(it->second);
+// time sequential and parallel depth labelling on generated deep and wide orbit maps,
+// checking that every thread count agrees with count_orbits()
+void benchmark_parallel_depths(size_t body_count, size_t max_threads)
+{
+    const std::pair<const char*, size_t> shapes[] = {{"deep", 4}, {"wide", body_count}};
+
+    for (const auto& [shape, spread] : shapes) {
+        OrbitIndex orbits;
+        parse_orbit_map(generate_orbit_map(body_count, spread, 1234), orbits);
+
+        auto start_time = std::chrono::steady_clock::now();
+        orbits.finalize();
+        const auto expected = orbits.count_orbits();
+        auto end_time = std::chrono::steady_clock::now();
+
+        uint32_t height = 0;
+        for (OrbitIndex::Id id = 0; id < orbits.size(); id++) height = std::max(height, orbits.depth(id));
+
+        std::cout << shape << ": " << orbits.size() << " bodies, height " << height << ", "
+                  << expected.first + expected.second << " orbits" << std::endl;
+        std::cout << "  sequential: "
+                  << std::chrono::duration_cast<std::chrono::microseconds>(end_time - start_time).count()
+                  << "us" << std::endl;
+
+        for (size_t threads = 1; threads <= max_threads; threads *= 2) {
+            start_time = std::chrono::steady_clock::now();
+            const auto counted = parallel_count_orbits(orbits, threads);
+            end_time = std::chrono::steady_clock::now();
+
+            std::cout << "  " << threads << " thread(s): "
+                      << std::chrono::duration_cast<std::chrono::microseconds>(end_time - start_time).count()
+                      << "us" << (counted == expected ? "" : " MISMATCH") << std::endl;
+            if (counted != expected) exit(EXIT_FAILURE);
         }
-    };
+    }
 
-    fill_tree(com_hash);
+    // maps with fewer bodies than threads, where the ranges don't divide evenly
+    for (size_t small_count = 1; small_count <= 17; small_count++) {
+        OrbitIndex orbits;
+        parse_orbit_map(generate_orbit_map(small_count, 4, 1234), orbits);
+        orbits.finalize();
+        const auto expected = orbits.count_orbits();
+
+        for (size_t threads = 1; threads <= std::max<size_t>(max_threads, 8); threads++) {
+            if (parallel_count_orbits(orbits, threads) != expected) {
+                std::cout << "small map of " << small_count << " bodies, " << threads
+                          << " thread(s): MISMATCH" << std::endl;
+                exit(EXIT_FAILURE);
+            }
+        }
+    }
+    std::cout << "small maps: ok" << std::endl;
+}
 
-    auto [direct_orbits, indirect_orbits] = tree.count_orbits();
+// usage: 6 [--query-bench [query count]] [--parse-bench <file>]
+//          [--depth-bench [body count] [max threads]]
+int main(int argc, char** argv)
+{
+    if (argc > 2 && std::string(argv[1]) == "--parse-bench") {
+        benchmark_parse(argv[2]);
+        return 0;
+    }
+    if (argc > 1 && std::string(argv[1]) == "--depth-bench") {
+        benchmark_parallel_depths(argc > 2 ? std::stoull(argv[2]) : 5000000,
+                                  argc > 3 ? std::stoull(argv[3]) : 32);
+        return 0;
+    }
 
-    assert(direct_orbits == orbit_map.size());
+    OrbitIndex orbits;
+    parse_orbit_map("../inputs/6.txt", orbits);
+    orbits.finalize();
+
+    auto [direct_orbits, indirect_orbits] = orbits.count_orbits();
 
     std::cout << "direct: " << direct_orbits << std::endl;
     std::cout << "indirect: " << indirect_orbits << std::endl;
     std::cout << "total: " << direct_orbits + indirect_orbits << std::endl;
+    assert(parallel_count_orbits(orbits, 4) == std::make_pair(direct_orbits, indirect_orbits));
+
+    const auto you = orbits.find("YOU");
+    const auto santa = orbits.find("SAN");
+    assert(you && santa);
 
-    auto d = tree.distance_between(you_orbiting_hash, santa_orbiting_hash);
-    assert(d);
-    std::cout << "you -> santa distance: " << *d << std::endl;
+    const OrbitDistanceOracle oracle(orbits);
+    const uint32_t d = oracle.distance(orbits.parent(*you), orbits.parent(*santa));
+    assert(d != OrbitDistanceOracle::NO_DISTANCE);
+    assert(d == *orbits.distance_between(orbits.parent(*you), orbits.parent(*santa)));
+    std::cout << "you -> santa distance: " << d << std::endl;
+
+    if (argc > 1 && std::string(argv[1]) == "--query-bench") {
+        benchmark_distance_queries(orbits, argc > 2 ? std::stoull(argv[2]) : 10000000);
+    }
 }
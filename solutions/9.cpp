@@ -1,8 +1,14 @@
 #include "intcode.hpp"
+#include "intcode_cache.hpp"
 
 int main(void)
 {
-    IntCodeVM vm("../inputs/9.txt");
-    vm.run_until_halt_with_single_input(2);
+    // the BOOST program is a pure function of its single input, so repeated runs can be
+    // answered straight from the on-disk result cache
+    IntCodeResultCache cache(16, "intcode_cache.bin");
+
+    for (IntType output : cache.run(read_program_from_file("../inputs/9.txt"), {2})) {
+        std::cout << output << std::endl;
+    }
     return 0;
 }
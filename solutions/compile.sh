@@ -1 +1 @@
-clang++ -g -std=c++17 -Wall $1
+clang++ -g -std=c++17 -Wall -pthread $1
@@ -1,11 +1,13 @@
 #pragma once
 
+#include <assert.h>
+
 #include <algorithm>
 #include <array>
 #include <chrono>
-#include <cmath>
 #include <fstream>
 #include <iostream>
+#include <optional>
 #include <vector>
 
 #include "magic_enum.hpp"
@@ -143,14 +145,14 @@ using namespace intcode_detail;
 
 class IntCodeVM {
 public:
-    enum class State;
+    enum class State { AwaitingInput, Halted, ReadyToBegin, Running };
 
 private:
     std::vector<IntType> m_memory;  // current memory state of IntCode machine
     size_t m_pc;                    // program counter
     State m_state;
-    int m_relative_base;
-    std::optional<int> m_input;
+    IntType m_relative_base;
+    std::optional<IntType> m_input;
 
     inline void allocate_up_to(size_t address)
     {
@@ -160,80 +162,55 @@ private:
         m_memory.resize(new_size_required, 0);
     }
 
-    Instruction parse_next_instruction(void)
+    // The parameter modes are the decimal digits of the opcode above the two op digits.
+    // Dividing by a small table of constants avoids the std::pow calls the older
+    // day 5/7 interpreters made for every parameter of every instruction.
+    static inline Parameter::Mode parameter_mode(IntType opcode, int index)
     {
-        panic_if(m_pc >= m_memory.size(), "Program counter moved past end of memory.");
-
-        Instruction inst;
-
-        const int opcode = read_memory(m_pc);
-        inst.code = opcode;
-        inst.op = code_to_op(opcode % 100);
-        panic_if(inst.op == Op::Unknown, "Unknown opcode encountered.");
-
-        const int pcount = param_count(inst.op);
-        assert(pcount >= 0 && pcount < 10);
-
-        const int powers_of_ten[max_param_count()] = {100, 1000, 10000};
-
-        for (int i = 0; i < pcount; i++) {
-            const int mode_int = (opcode / powers_of_ten[i]) % 10;
-            auto& mode = inst.params[i].mode;
-
-            if (mode_int == 0) {
-                mode = Parameter::Mode::Position;
-            }
-            else if (mode_int == 1) {
-                mode = Parameter::Mode::Immediate;
-            }
-            else {
-                assert(mode_int == 2);
-                mode = Parameter::Mode::Relative;
-            }
-
-            inst.params[i].value = read_memory(m_pc + i + 1);
-        }
-
-        return inst;
+        constexpr IntType mode_divisors[max_param_count()] = {100, 1000, 10000};
+        const IntType mode_int = (opcode / mode_divisors[index]) % 10;
+        assert(mode_int >= 0 && mode_int <= 2);
+        return static_cast<Parameter::Mode>(mode_int);
     }
 
-    inline IntType extract_parameter(Parameter param)
+    inline IntType load_parameter(IntType opcode, int index)
     {
-        switch (param.mode) {
+        const IntType value = read_memory(m_pc + index + 1);
+
+        switch (parameter_mode(opcode, index)) {
             case Parameter::Mode::Immediate:
-                return param.value;
+                return value;
             case Parameter::Mode::Position:
-                return read_memory(param.value);
+                return read_memory(value);
             case Parameter::Mode::Relative:
-                return read_memory(m_relative_base + param.value);
+                return read_memory(m_relative_base + value);
         }
-    };
+
+        return 0;
+    }
 
     // output address parameters have different mode rules than normal op parameters
-    inline IntType extract_output_parameter(Parameter param)
+    inline IntType output_address(IntType opcode, int index)
     {
-        assert(param.mode != Parameter::Mode::Immediate);
+        const IntType value = read_memory(m_pc + index + 1);
+        const Parameter::Mode mode = parameter_mode(opcode, index);
+        assert(mode != Parameter::Mode::Immediate);
 
-        if (param.mode == Parameter::Mode::Position) {
-            return param.value;
-        }
-        else {
-            return m_relative_base + param.value;
-        }
-    };
-
-    IntCodeVM(const std::vector<IntType>& program)
-        : m_memory(program), m_pc(0), m_state(State::ReadyToBegin), m_relative_base(0), m_input({})
-    {
+        return mode == Parameter::Mode::Relative ? m_relative_base + value : value;
     }
 
 public:
-    IntCodeVM(const char* filepath) : IntCodeVM(read_program_from_file(filepath))
+    IntCodeVM(std::vector<IntType> program)
+        : m_memory(std::move(program)),
+          m_pc(0),
+          m_state(State::ReadyToBegin),
+          m_relative_base(0),
+          m_input(std::nullopt)
     {
         allocate_up_to(2000);
     }
 
-    enum class State { AwaitingInput, Halted, ReadyToBegin, Running };
+    IntCodeVM(const char* filepath) : IntCodeVM(read_program_from_file(filepath)) {}
 
     inline IntType read_memory(size_t address)
     {
@@ -248,106 +225,117 @@ public:
     }
 
     State get_state(void) const { return m_state; }
+    bool is_halted(void) const { return m_state == State::Halted; }
 
     void set_input(IntType input) { m_input = input; }
 
-    // return value: either empty on halt, or pauses the execution and returns a single
-    // output
-    std::optional<IntType> continue_execution(void)
+    // return value: either empty on halt or when input is required, or pauses the
+    // execution and returns a single output. A non-empty 'input' is consumed by the next
+    // Input instruction encountered.
+    std::optional<IntType> continue_execution(std::optional<IntType> input = {})
     {
         assert(m_state != State::Halted);
+        if (input) m_input = input;
         assert(!(!m_input && m_state == State::AwaitingInput));
 
-        if (m_state == State::ReadyToBegin) m_state = State::Running;
-        assert(m_state == State::Running || m_state == State::AwaitingInput);
+        m_state = State::Running;
 
-        std::optional<IntType> output;
         while (true) {
-            bool increment_pc_by_par_count = true;
-
-            const Instruction inst = parse_next_instruction();
-            if (m_state == State::AwaitingInput) assert(inst.op == Op::Input);
-
-            // TODO: switch on parameter count to reduce code duplication
-            if (inst.op == Op::Addition || inst.op == Op::Multiplication) {
-                const IntType x = extract_parameter(inst.params[0]);
-                const IntType y = extract_parameter(inst.params[1]);
-                const IntType out_addr = extract_output_parameter(inst.params[2]);
-
-                if (inst.op == Op::Addition) {
-                    write_memory(out_addr, x + y);
-                }
-                else {
-                    assert(inst.op == Op::Multiplication);
-                    write_memory(out_addr, x * y);
+            panic_if(m_pc >= m_memory.size(), "Program counter moved past end of memory.");
+            const IntType opcode = m_memory[m_pc];
+
+            switch (code_to_op(opcode % 100)) {
+                case Op::Addition:
+                    write_memory(output_address(opcode, 2),
+                                 load_parameter(opcode, 0) + load_parameter(opcode, 1));
+                    m_pc += 4;
+                    break;
+                case Op::Multiplication:
+                    write_memory(output_address(opcode, 2),
+                                 load_parameter(opcode, 0) * load_parameter(opcode, 1));
+                    m_pc += 4;
+                    break;
+                case Op::Input:
+                    if (!m_input) {
+                        m_state = State::AwaitingInput;
+                        return {};
+                    }
+                    write_memory(output_address(opcode, 0), *m_input);
+                    m_input = {};
+                    m_pc += 2;
+                    break;
+                case Op::Output: {
+                    const IntType output = load_parameter(opcode, 0);
+                    m_pc += 2;
+                    return output;
                 }
-            }
-            else if (inst.op == Op::Input) {
-                if (!m_input) {
-                    m_state = State::AwaitingInput;
+                case Op::JumpIfTrue:
+                    m_pc = load_parameter(opcode, 0) != 0 ? load_parameter(opcode, 1) : m_pc + 3;
+                    break;
+                case Op::JumpIfFalse:
+                    m_pc = load_parameter(opcode, 0) == 0 ? load_parameter(opcode, 1) : m_pc + 3;
+                    break;
+                case Op::LessThan:
+                    write_memory(output_address(opcode, 2),
+                                 load_parameter(opcode, 0) < load_parameter(opcode, 1) ? 1 : 0);
+                    m_pc += 4;
+                    break;
+                case Op::Equals:
+                    write_memory(output_address(opcode, 2),
+                                 load_parameter(opcode, 0) == load_parameter(opcode, 1) ? 1 : 0);
+                    m_pc += 4;
+                    break;
+                case Op::ModifyRelativeBase:
+                    m_relative_base += load_parameter(opcode, 0);
+                    m_pc += 2;
+                    break;
+                case Op::Halt:
+                    m_state = State::Halted;
                     return {};
-                }
-
-                const IntType out_addr = extract_output_parameter(inst.params[0]);
-                write_memory(out_addr, *m_input);
-                m_input = {};
-                m_state = State::Running;
-            }
-            else if (inst.op == Op::Output) {
-                // don't return output yet, we still need to increment the program counter
-                // below.
-                output = extract_parameter(inst.params[0]);
-            }
-            else if (inst.op == Op::Halt) {
-                m_state = State::Halted;
-                return {};
+                case Op::Unknown:
+                    panic_if(true, "Unknown opcode encountered.");
             }
-            else if (inst.op == Op::JumpIfTrue) {
-                const IntType x = extract_parameter(inst.params[0]);
-                const IntType y = extract_parameter(inst.params[1]);
+        }
+    }
 
-                if (x != 0) {
-                    m_pc = y;
-                    increment_pc_by_par_count = false;
-                }
-            }
-            else if (inst.op == Op::JumpIfFalse) {
-                const IntType x = extract_parameter(inst.params[0]);
-                const IntType y = extract_parameter(inst.params[1]);
+    // Run until the program halts or asks for more input than it was given, appending every
+    // output along the way. Returns false once the program has halted.
+    bool run_until_input(std::vector<IntType>& outputs, std::optional<IntType> input = {})
+    {
+        while (auto output = continue_execution(input)) {
+            outputs.push_back(*output);
+            input = {};
+        }
+        return !is_halted();
+    }
 
-                if (x == 0) {
-                    m_pc = y;
-                    increment_pc_by_par_count = false;
-                }
-            }
-            else if (inst.op == Op::LessThan) {
-                const IntType x = extract_parameter(inst.params[0]);
-                const IntType y = extract_parameter(inst.params[1]);
-                const IntType out_addr = extract_output_parameter(inst.params[2]);
+    // Run a program to completion, feeding it 'inputs' in order, and collect all of its
+    // outputs along the way.
+    std::vector<IntType> run_until_halt_with_inputs(const std::vector<IntType>& inputs)
+    {
+        std::vector<IntType> outputs;
+        auto next_input = inputs.begin();
 
-                write_memory(out_addr, x < y ? 1 : 0);
-            }
-            else if (inst.op == Op::Equals) {
-                const IntType x = extract_parameter(inst.params[0]);
-                const IntType y = extract_parameter(inst.params[1]);
-                const IntType out_addr = extract_output_parameter(inst.params[2]);
+        while (true) {
+            auto output = continue_execution();
 
-                write_memory(out_addr, x == y ? 1 : 0);
+            if (output) {
+                outputs.push_back(*output);
             }
-            else if (inst.op == Op::ModifyRelativeBase) {
-                const IntType x = extract_parameter(inst.params[0]);
-                m_relative_base += x;
+            else if (is_halted()) {
+                return outputs;
             }
             else {
-                assert(false && "Invalid opcode encountered");
+                panic_if(next_input == inputs.end(), "Program requested more inputs than provided.");
+                set_input(*next_input++);
             }
-
-            if (increment_pc_by_par_count) {
-                m_pc += param_count(inst.op) + 1;
-            }
-
-            if (output) return output;
         }
     }
-};
 
+    // Run a program which reads at most one input value to completion, and collect all of
+    // its outputs along the way.
+    std::vector<IntType> run_until_halt_with_single_input(IntType input)
+    {
+        return run_until_halt_with_inputs({input});
+    }
+};
@@ -0,0 +1,362 @@
+#pragma once
+
+#include <algorithm>
+#include <optional>
+#include <ostream>
+#include <vector>
+
+#include "intcode.hpp"
+
+// Static analysis of Intcode programs: disassembly into basic blocks and a control flow
+// graph. Code and data are freely mixed in Intcode, so rather than sweeping linearly over
+// memory we only decode what is reachable from address 0, following jump targets wherever
+// they are immediate parameters.
+
+namespace intcode_analysis {
+
+struct DecodedInstruction {
+    size_t address;
+    Instruction inst;
+
+    size_t length(void) const { return param_count(inst.op) + 1; }
+};
+
+struct BasicBlock {
+    size_t start;  // address of the first instruction
+    size_t end;    // one past the last memory cell of the last instruction
+
+    size_t first_instruction;  // index into ControlFlowGraph::instructions
+    size_t instruction_count;
+
+    // indices into ControlFlowGraph::blocks. A block ends in at most one conditional jump,
+    // so it can never have more than two successors.
+    size_t successors[2];
+    size_t successor_count;
+
+    bool has_indirect_jump;  // ends in a jump whose target is only known at runtime
+    bool halts;
+
+    // control flow leaves the block for an address that doesn't decode (or lies past the end
+    // of memory), typically code that the program patches before reaching it. There is no
+    // block there, so that edge is missing from 'successors'.
+    bool reaches_undecodable;
+};
+
+// A Position mode write whose target address overlaps an instruction we decoded, or an
+// address control flow reaches that didn't decode.
+struct SelfModifyingWrite {
+    size_t instruction_address;
+    size_t target_address;
+};
+
+struct ControlFlowGraph {
+    std::vector<DecodedInstruction> instructions;  // sorted by address
+    std::vector<BasicBlock> blocks;                // sorted by start address
+    std::vector<SelfModifyingWrite> self_modifying_writes;
+
+    // maps a block start address back to its index in 'blocks'
+    std::optional<size_t> block_at(size_t address) const
+    {
+        auto it = std::lower_bound(blocks.begin(), blocks.end(), address,
+                                   [](const BasicBlock& b, size_t a) { return b.start < a; });
+        if (it == blocks.end() || it->start != address) return {};
+        return it - blocks.begin();
+    }
+};
+
+static std::optional<Instruction> decode_instruction(const std::vector<IntType>& program,
+                                                     size_t address)
+{
+    if (address >= program.size()) return {};
+
+    const IntType code = program[address];
+    if (code <= 0) return {};
+
+    Instruction inst;
+    inst.code = code;
+    inst.op = code_to_op(code % 100);
+    if (inst.op == Op::Unknown) return {};
+
+    const int pcount = param_count(inst.op);
+    if (address + pcount >= program.size()) return {};
+
+    IntType modes = code / 100;
+    for (int i = 0; i < pcount; i++) {
+        const IntType mode_int = modes % 10;
+        if (mode_int > 2) return {};
+        inst.params[i].mode = static_cast<Parameter::Mode>(mode_int);
+        inst.params[i].value = program[address + i + 1];
+        modes /= 10;
+    }
+
+    // leftover digits mean this isn't really an instruction
+    if (modes != 0) return {};
+
+    return inst;
+}
+
+static inline bool is_jump(Op op) { return op == Op::JumpIfTrue || op == Op::JumpIfFalse; }
+
+static inline bool writes_memory(Op op)
+{
+    return op == Op::Addition || op == Op::Multiplication || op == Op::Input ||
+           op == Op::LessThan || op == Op::Equals;
+}
+
+// index of the parameter holding the output address, for ops where writes_memory is true
+static inline int output_param_index(Op op) { return param_count(op) - 1; }
+
+// If the branch condition is an immediate, the jump is either always or never taken.
+static inline std::optional<bool> static_branch_outcome(const Instruction& inst)
+{
+    assert(is_jump(inst.op));
+    const Parameter& condition = inst.params[0];
+    if (condition.mode != Parameter::Mode::Immediate) return {};
+
+    return inst.op == Op::JumpIfTrue ? condition.value != 0 : condition.value == 0;
+}
+
+static inline std::optional<size_t> static_jump_target(const Instruction& inst)
+{
+    assert(is_jump(inst.op));
+    const Parameter& target = inst.params[1];
+    if (target.mode != Parameter::Mode::Immediate || target.value < 0) return {};
+    return static_cast<size_t>(target.value);
+}
+
+static ControlFlowGraph build_cfg(const std::vector<IntType>& program)
+{
+    ControlFlowGraph cfg;
+
+    // per memory cell flags, so that all bookkeeping is O(1) per address
+    enum : uint8_t { Visited = 1, Leader = 2, CodeCell = 4, Undecodable = 8 };
+    std::vector<uint8_t> flags(program.size(), 0);
+
+    size_t instruction_count = 0;
+    std::vector<size_t> worklist;
+    auto enqueue = [&](size_t address) {
+        if (address >= program.size()) return;
+        flags[address] |= Leader;
+        if (!(flags[address] & Visited)) worklist.push_back(address);
+    };
+
+    enqueue(0);
+
+    while (!worklist.empty()) {
+        size_t address = worklist.back();
+        worklist.pop_back();
+
+        // decode straight-line code until we hit a terminator or already visited code
+        while (address < program.size() && !(flags[address] & Visited)) {
+            const auto inst = decode_instruction(program, address);
+            if (!inst) {
+                // still code as far as control flow is concerned; most likely it's patched by
+                // an earlier write before it runs
+                flags[address] |= CodeCell | Undecodable;
+                break;
+            }
+
+            flags[address] |= Visited;
+            instruction_count++;
+
+            const size_t next = address + param_count(inst->op) + 1;
+            for (size_t a = address; a < next; a++) flags[a] |= CodeCell;
+
+            if (inst->op == Op::Halt) break;
+
+            if (is_jump(inst->op)) {
+                const auto outcome = static_branch_outcome(*inst);
+                const auto target = static_jump_target(*inst);
+
+                if (target && outcome.value_or(true)) enqueue(*target);
+                if (outcome && *outcome) break;  // unconditional jump, no fall through
+
+                enqueue(next);
+                break;
+            }
+
+            address = next;
+        }
+    }
+
+    // collect the instructions in address order with a linear scan rather than a sort
+    cfg.instructions.reserve(instruction_count);
+    for (size_t address = 0; address < program.size(); address++) {
+        if (flags[address] & Visited) {
+            cfg.instructions.push_back({address, *decode_instruction(program, address)});
+        }
+    }
+
+    // split the sorted instruction stream into blocks at leaders and after terminators
+    for (size_t i = 0; i < cfg.instructions.size(); i++) {
+        const DecodedInstruction& di = cfg.instructions[i];
+
+        const bool starts_block = cfg.blocks.empty() || (flags[di.address] & Leader) ||
+                                  cfg.blocks.back().end != di.address;
+
+        if (starts_block) {
+            cfg.blocks.push_back({di.address, di.address, i, 0, {0, 0}, 0, false, false, false});
+        }
+
+        BasicBlock& block = cfg.blocks.back();
+        block.end = di.address + di.length();
+        block.instruction_count++;
+
+        const Op op = di.inst.op;
+        if (op == Op::Halt) {
+            block.halts = true;
+        }
+        if (is_jump(op) || op == Op::Halt) {
+            // force the next instruction into a new block
+            if (i + 1 < cfg.instructions.size()) {
+                flags[cfg.instructions[i + 1].address] |= Leader;
+            }
+        }
+    }
+
+    // resolve successor edges now that every block start is known
+    for (BasicBlock& block : cfg.blocks) {
+        const DecodedInstruction& last =
+            cfg.instructions[block.first_instruction + block.instruction_count - 1];
+
+        auto add_successor = [&](size_t address) {
+            if (address >= program.size() || (flags[address] & Undecodable)) {
+                block.reaches_undecodable = true;
+            }
+            else if (auto index = cfg.block_at(address)) {
+                block.successors[block.successor_count++] = *index;
+            }
+        };
+
+        if (last.inst.op == Op::Halt) continue;
+
+        if (is_jump(last.inst.op)) {
+            const auto outcome = static_branch_outcome(last.inst);
+            const auto target = static_jump_target(last.inst);
+
+            if (outcome.value_or(true)) {
+                if (target) {
+                    add_successor(*target);
+                }
+                else {
+                    block.has_indirect_jump = true;
+                }
+            }
+            if (!outcome || !*outcome) add_successor(block.end);
+        }
+        else {
+            add_successor(block.end);
+        }
+    }
+
+    // flag writes with statically known addresses that land on decoded code
+    for (const DecodedInstruction& di : cfg.instructions) {
+        if (!writes_memory(di.inst.op)) continue;
+
+        const Parameter& out = di.inst.params[output_param_index(di.inst.op)];
+        if (out.mode != Parameter::Mode::Position || out.value < 0) continue;
+
+        const size_t target = static_cast<size_t>(out.value);
+        if (target < flags.size() && (flags[target] & CodeCell)) {
+            cfg.self_modifying_writes.push_back({di.address, target});
+        }
+    }
+
+    return cfg;
+}
+
+// {{{ OUTPUT
+
+static void print_parameter(std::ostream& os, const Parameter& param)
+{
+    switch (param.mode) {
+        case Parameter::Mode::Position:
+            os << "[" << param.value << "]";
+            break;
+        case Parameter::Mode::Immediate:
+            os << param.value;
+            break;
+        case Parameter::Mode::Relative:
+            os << "[rb" << (param.value < 0 ? "" : "+") << param.value << "]";
+            break;
+    }
+}
+
+static void print_instruction(std::ostream& os, const DecodedInstruction& di)
+{
+    os << di.address << ": " << magic_enum::enum_name(di.inst.op);
+    for (int i = 0; i < param_count(di.inst.op); i++) {
+        os << (i == 0 ? " " : ", ");
+        print_parameter(os, di.inst.params[i]);
+    }
+}
+
+static void print_cfg_text(std::ostream& os, const ControlFlowGraph& cfg)
+{
+    for (size_t b = 0; b < cfg.blocks.size(); b++) {
+        const BasicBlock& block = cfg.blocks[b];
+
+        os << "block " << b << " [" << block.start << ", " << block.end << ")";
+        if (block.successor_count > 0) {
+            os << " ->";
+            for (size_t s = 0; s < block.successor_count; s++) os << " " << block.successors[s];
+        }
+        if (block.has_indirect_jump) os << " (indirect jump)";
+        if (block.halts) os << " (halts)";
+        if (block.reaches_undecodable) os << " (runs into undecodable code)";
+        os << '\n';
+
+        for (size_t i = 0; i < block.instruction_count; i++) {
+            os << "    ";
+            print_instruction(os, cfg.instructions[block.first_instruction + i]);
+            os << '\n';
+        }
+    }
+
+    os << '\n' << cfg.self_modifying_writes.size() << " self-modifying write(s)\n";
+    for (const SelfModifyingWrite& w : cfg.self_modifying_writes) {
+        os << "    " << w.instruction_address << " writes to code at " << w.target_address << '\n';
+    }
+}
+
+static void print_cfg_graphviz(std::ostream& os, const ControlFlowGraph& cfg)
+{
+    os << "digraph intcode {\n";
+    os << "    node [shape=box, fontname=monospace];\n";
+
+    for (size_t b = 0; b < cfg.blocks.size(); b++) {
+        const BasicBlock& block = cfg.blocks[b];
+
+        os << "    b" << b << " [label=\"";
+        for (size_t i = 0; i < block.instruction_count; i++) {
+            print_instruction(os, cfg.instructions[block.first_instruction + i]);
+            os << "\\l";
+        }
+        os << "\"";
+        if (block.has_indirect_jump) os << ", style=dashed";
+        if (block.reaches_undecodable) os << ", color=orange";
+        os << "];\n";
+
+        for (size_t s = 0; s < block.successor_count; s++) {
+            os << "    b" << b << " -> b" << block.successors[s] << ";\n";
+        }
+    }
+
+    for (const SelfModifyingWrite& w : cfg.self_modifying_writes) {
+        const auto from = std::upper_bound(cfg.blocks.begin(), cfg.blocks.end(),
+                                           w.instruction_address,
+                                           [](size_t a, const BasicBlock& b) { return a < b.start; });
+        const auto to = std::upper_bound(cfg.blocks.begin(), cfg.blocks.end(), w.target_address,
+                                         [](size_t a, const BasicBlock& b) { return a < b.start; });
+        if (from == cfg.blocks.begin() || to == cfg.blocks.begin()) continue;
+
+        os << "    b" << (from - cfg.blocks.begin() - 1) << " -> b" << (to - cfg.blocks.begin() - 1)
+           << " [style=dotted, color=red];\n";
+    }
+
+    os << "}\n";
+}
+
+// }}}
+
+}  // namespace intcode_analysis
@@ -0,0 +1,207 @@
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <iostream>
+#include <map>
+#include <numeric>
+#include <vector>
+
+#include "intcode.hpp"
+#include "intcode_cache.hpp"
+
+// Runs every Intcode day through IntCodeVM with the same call patterns the solutions use,
+// so that changes to the VM can be measured against real workloads rather than synthetic
+// instruction mixes.
+
+namespace {
+
+template <typename Workload>
+void bench(const char* name, size_t iterations, Workload&& workload)
+{
+    const IntType answer = workload();  // warm up and sanity check
+
+    std::vector<int64_t> times;
+    times.reserve(iterations);
+
+    for (size_t i = 0; i < iterations; i++) {
+        const auto start_time = std::chrono::steady_clock::now();
+        const IntType result = workload();
+        const auto end_time = std::chrono::steady_clock::now();
+
+        panic_if(result != answer, "Benchmark workload produced inconsistent results.");
+        times.push_back(
+            std::chrono::duration_cast<std::chrono::microseconds>(end_time - start_time).count());
+    }
+
+    const int64_t min_time = *std::min_element(times.begin(), times.end());
+    const int64_t mean_time = std::accumulate(times.begin(), times.end(), int64_t(0)) / iterations;
+
+    std::cout << name << ": answer = " << answer << ", min = " << min_time
+              << "us, mean = " << mean_time << "us" << std::endl;
+}
+
+IntType day_two(const std::vector<IntType>& program)
+{
+    for (IntType noun = 0; noun <= 99; noun++) {
+        for (IntType verb = 0; verb <= 99; verb++) {
+            IntCodeVM vm(program);
+            vm.write_memory(1, noun);
+            vm.write_memory(2, verb);
+            vm.continue_execution();
+            assert(vm.is_halted());
+            if (vm.read_memory(0) == 19690720) return 100 * noun + verb;
+        }
+    }
+
+    return -1;
+}
+
+IntType last_output(const std::vector<IntType>& program, IntType input)
+{
+    IntCodeVM vm(program);
+    const auto outputs = vm.run_until_halt_with_single_input(input);
+    return outputs.empty() ? -1 : outputs.back();
+}
+
+IntType day_seven(const std::vector<IntType>& program, bool feedback)
+{
+    std::array<IntType, 5> phases = {0, 1, 2, 3, 4};
+    if (feedback) {
+        phases = {5, 6, 7, 8, 9};
+    }
+
+    IntType max_signal = std::numeric_limits<IntType>::min();
+
+    do {
+        std::vector<IntCodeVM> amps(5, IntCodeVM(program));
+        for (size_t i = 0; i < 5; i++) {
+            amps[i].continue_execution(phases[i]);
+        }
+
+        IntType signal = 0;
+        bool halted = false;
+        while (!halted) {
+            for (auto& amp : amps) {
+                auto output = amp.continue_execution(signal);
+                if (!output) {
+                    halted = true;
+                    break;
+                }
+                signal = *output;
+            }
+            if (!feedback) break;
+        }
+
+        max_signal = std::max(max_signal, signal);
+    } while (std::next_permutation(phases.begin(), phases.end()));
+
+    return max_signal;
+}
+
+IntType day_eleven(const std::vector<IntType>& program)
+{
+    IntCodeVM vm(program);
+    std::map<std::pair<int, int>, IntType> hull;
+    std::pair<int, int> position = {0, 0};
+    int direction = 0;  // 0 = up, then clockwise
+
+    constexpr int dx[4] = {0, 1, 0, -1};
+    constexpr int dy[4] = {1, 0, -1, 0};
+
+    while (true) {
+        auto it = hull.find(position);
+        auto color = vm.continue_execution(it == hull.end() ? 0 : it->second);
+        if (!color) break;
+        hull[position] = *color;
+
+        auto turn = vm.continue_execution();
+        assert(turn);
+        direction = (direction + (*turn == 0 ? 3 : 1)) % 4;
+        position.first += dx[direction];
+        position.second += dy[direction];
+    }
+
+    return hull.size();
+}
+
+IntType day_thirteen(const std::vector<IntType>& program)
+{
+    IntCodeVM vm(program);
+
+    size_t output_count = 0;
+    IntType block_count = 0;
+
+    while (auto output = vm.continue_execution()) {
+        output_count++;
+        if (output_count % 3 == 0 && *output == 2) {
+            block_count++;
+        }
+    }
+
+    return block_count;
+}
+
+// plays the whole game with the same ball-tracking autopilot as 13_2.cpp
+IntType day_thirteen_autopilot(const std::vector<IntType>& program)
+{
+    IntCodeVM vm(program);
+    vm.write_memory(0, 2);
+
+    IntType score = 0;
+    IntType ball_x = 0;
+    IntType paddle_x = 0;
+
+    while (!vm.is_halted()) {
+        auto x = vm.continue_execution((ball_x > paddle_x) - (ball_x < paddle_x));
+        if (!x) continue;
+
+        const IntType y = *vm.continue_execution();
+        const IntType code = *vm.continue_execution();
+
+        if (*x == -1 && y == 0) {
+            score = code;
+        }
+        else if (code == 3) {
+            paddle_x = *x;
+        }
+        else if (code == 4) {
+            ball_x = *x;
+        }
+    }
+
+    return score;
+}
+
+}  // namespace
+
+int main(void)
+{
+    std::ios_base::sync_with_stdio(false);
+
+    const auto program_2 = read_program_from_file("../inputs/2.txt");
+    const auto program_5 = read_program_from_file("../inputs/5.txt");
+    const auto program_7 = read_program_from_file("../inputs/7.txt");
+    const auto program_9 = read_program_from_file("../inputs/9.txt");
+    const auto program_11 = read_program_from_file("../inputs/11.txt");
+    const auto program_13 = read_program_from_file("../inputs/13.txt");
+
+    bench("day 2 (noun/verb search)", 20, [&]() { return day_two(program_2); });
+    bench("day 5 part one", 1000, [&]() { return last_output(program_5, 1); });
+    bench("day 5 part two", 1000, [&]() { return last_output(program_5, 5); });
+    bench("day 7 part one", 100, [&]() { return day_seven(program_7, false); });
+    bench("day 7 part two", 100, [&]() { return day_seven(program_7, true); });
+    bench("day 9 part one", 1000, [&]() { return last_output(program_9, 1); });
+    bench("day 9 part two", 10, [&]() { return last_output(program_9, 2); });
+
+    IntCodeResultCache cache(16);
+    const IntCodeResultCache::ProgramKey program_9_key = IntCodeResultCache::hash_program(program_9);
+    bench("day 9 part two (memoized)", 1000, [&]() {
+        return cache.run(program_9, program_9_key, {2}).back();
+    });
+
+    bench("day 11 part one", 20, [&]() { return day_eleven(program_11); });
+    bench("day 13 part one", 100, [&]() { return day_thirteen(program_13); });
+    bench("day 13 part two (autopilot)", 20, [&]() { return day_thirteen_autopilot(program_13); });
+
+    return 0;
+}
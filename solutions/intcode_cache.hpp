@@ -0,0 +1,387 @@
+#pragma once
+
+#include <fcntl.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstring>
+#include <list>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+#include "intcode.hpp"
+
+// Memoization of Intcode runs which are pure functions of their input sequence (the program
+// halts after consuming a fixed list of inputs, like days 5 and 9). Results are keyed by
+// (program hash and length, input sequence) and looked up first in an in-memory LRU, then in an
+// on-disk open addressing hash table which is mmap'd so that later processes can reuse it.
+
+namespace intcode_cache_detail {
+
+// FNV-1a over the raw bytes of the values
+static inline uint64_t hash_values(const std::vector<IntType>& values,
+                                   uint64_t seed = 14695981039346656037ULL)
+{
+    uint64_t h = seed;
+    for (IntType v : values) {
+        const uint64_t u = static_cast<uint64_t>(v);
+        for (int shift = 0; shift < 64; shift += 8) {
+            h ^= (u >> shift) & 0xff;
+            h *= 1099511628211ULL;
+        }
+    }
+    // mix in the length so that e.g. {} and {0} differ
+    h ^= values.size();
+    h *= 1099511628211ULL;
+    return h;
+}
+
+// Programs are identified by a hash and their length rather than their full contents, so
+// two programs only get confused if they are the same length and their hashes collide
+struct ProgramKey {
+    uint64_t hash;
+    uint64_t length;
+
+    friend bool operator==(const ProgramKey& a, const ProgramKey& b)
+    {
+        return a.hash == b.hash && a.length == b.length;
+    }
+};
+
+struct CacheKey {
+    ProgramKey program;
+    std::vector<IntType> inputs;
+
+    friend bool operator==(const CacheKey& a, const CacheKey& b)
+    {
+        return a.program == b.program && a.inputs == b.inputs;
+    }
+};
+
+struct CacheKeyHash {
+    size_t operator()(const CacheKey& key) const { return hash_values(key.inputs, key.program.hash); }
+};
+
+// On-disk layout: a Header, then 'slot_count' Slots, then 'data_capacity' IntType cells
+// holding every stored result back to back, each as its input sequence followed by its
+// outputs. The table is append-only; once either the slots or the data region fill up, new
+// results simply aren't persisted. Slots are found by hash, but a hit must also match the
+// program length and the stored input sequence exactly, like the in-memory LRU.
+//
+// Several processes may share the file. Writers (and the first process to size a fresh file)
+// take an exclusive flock; readers don't lock at all, but a slot's 'occupied' flag is only
+// set, with a release store, after everything it points at has been written, and is read
+// with an acquire load. Anything read back from the file is bounds checked, since the file
+// may be stale or corrupt.
+class DiskTable {
+    static constexpr uint64_t MAGIC = 0x32454843414349ULL;  // "ICACHE2"
+
+    struct Header {
+        uint64_t magic;
+        uint64_t slot_count;  // always a power of two
+        uint64_t data_capacity;
+        uint64_t data_used;
+    };
+
+    struct Slot {
+        uint64_t program_hash;
+        uint64_t program_length;
+        uint64_t input_hash;
+        uint64_t data_offset;  // the inputs start here, and the outputs follow them
+        uint64_t input_count;
+        uint64_t output_count;
+        uint64_t occupied;
+    };
+
+    int m_fd;  // kept open for flock
+    void* m_mapping;
+    size_t m_mapping_size;
+    Header* m_header;
+    Slot* m_slots;
+    IntType* m_data;
+
+    static size_t file_size_for(uint64_t slot_count, uint64_t data_capacity)
+    {
+        return sizeof(Header) + slot_count * sizeof(Slot) + data_capacity * sizeof(IntType);
+    }
+
+    // a header read from disk must describe exactly the file it came from
+    static bool header_is_valid(const Header& header, size_t file_size)
+    {
+        const uint64_t max_cells = file_size / sizeof(IntType);
+        return header.magic == MAGIC && header.slot_count != 0 &&
+               (header.slot_count & (header.slot_count - 1)) == 0 &&
+               header.slot_count <= file_size / sizeof(Slot) && header.data_capacity <= max_cells &&
+               header.data_used <= header.data_capacity &&
+               file_size_for(header.slot_count, header.data_capacity) == file_size;
+    }
+
+    static bool is_occupied(const Slot* slot)
+    {
+        return __atomic_load_n(&slot->occupied, __ATOMIC_ACQUIRE) != 0;
+    }
+
+    // a stale or corrupt slot mustn't send us past the end of the mapping
+    bool data_in_bounds(const Slot* slot) const
+    {
+        const uint64_t capacity = m_header->data_capacity;
+        return slot->input_count <= capacity && slot->output_count <= capacity - slot->input_count &&
+               slot->data_offset <= capacity - slot->input_count - slot->output_count;
+    }
+
+    bool matches(const Slot* slot, const ProgramKey& program, uint64_t input_hash,
+                 const std::vector<IntType>& inputs) const
+    {
+        return slot->program_hash == program.hash && slot->program_length == program.length &&
+               slot->input_hash == input_hash && slot->input_count == inputs.size() &&
+               data_in_bounds(slot) && std::equal(inputs.begin(), inputs.end(), m_data + slot->data_offset);
+    }
+
+    // the slot holding this exact key, or the empty slot where it belongs
+    Slot* find_slot(const ProgramKey& program, uint64_t input_hash, const std::vector<IntType>& inputs) const
+    {
+        const uint64_t mask = m_header->slot_count - 1;
+        for (uint64_t probe = 0; probe < m_header->slot_count; probe++) {
+            Slot* slot = &m_slots[((input_hash ^ program.hash) + probe) & mask];
+            if (!is_occupied(slot) || matches(slot, program, input_hash, inputs)) return slot;
+        }
+        return nullptr;
+    }
+
+    // RAII exclusive flock on the cache file
+    class WriteLock {
+        int m_fd;
+
+    public:
+        explicit WriteLock(int fd) : m_fd(fd) { flock(m_fd, LOCK_EX); }
+        ~WriteLock(void) { flock(m_fd, LOCK_UN); }
+        WriteLock(const WriteLock&) = delete;
+        WriteLock& operator=(const WriteLock&) = delete;
+    };
+
+public:
+    DiskTable(const char* filepath, uint64_t slot_count, uint64_t data_capacity)
+        : m_fd(-1),
+          m_mapping(nullptr),
+          m_mapping_size(0),
+          m_header(nullptr),
+          m_slots(nullptr),
+          m_data(nullptr)
+    {
+        panic_if(slot_count == 0 || (slot_count & (slot_count - 1)) != 0,
+                 "Disk cache slot count must be a power of two.");
+
+        m_fd = open(filepath, O_RDWR | O_CREAT, 0644);
+        if (m_fd < 0) {
+            std::cerr << "WARNING: unable to open Intcode cache file " << filepath << std::endl;
+            return;
+        }
+
+        // held while sizing and mapping, so that two processes can't both initialise a fresh
+        // file, or map one that is still being initialised
+        WriteLock lock(m_fd);
+
+        struct stat st;
+        fstat(m_fd, &st);
+
+        const bool fresh = st.st_size == 0;
+        if (fresh) {
+            m_mapping_size = file_size_for(slot_count, data_capacity);
+            panic_if(ftruncate(m_fd, m_mapping_size) != 0, "Failed to size Intcode cache file.");
+        }
+        else {
+            m_mapping_size = st.st_size;
+        }
+
+        if (!fresh && m_mapping_size < sizeof(Header)) {
+            std::cerr << "WARNING: ignoring malformed Intcode cache file " << filepath << std::endl;
+            return;
+        }
+
+        void* mapping = mmap(nullptr, m_mapping_size, PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, 0);
+        if (mapping == MAP_FAILED) {
+            std::cerr << "WARNING: unable to map Intcode cache file " << filepath << std::endl;
+            return;
+        }
+
+        m_mapping = mapping;
+        m_header = static_cast<Header*>(m_mapping);
+
+        if (fresh) {
+            // ftruncate zero fills, so every slot already reads as unoccupied
+            *m_header = {MAGIC, slot_count, data_capacity, 0};
+        }
+        else if (!header_is_valid(*m_header, m_mapping_size)) {
+            std::cerr << "WARNING: ignoring malformed Intcode cache file " << filepath << std::endl;
+            munmap(m_mapping, m_mapping_size);
+            m_mapping = nullptr;
+            m_header = nullptr;
+            return;
+        }
+
+        m_slots = reinterpret_cast<Slot*>(m_header + 1);
+        m_data = reinterpret_cast<IntType*>(m_slots + m_header->slot_count);
+    }
+
+    DiskTable(const DiskTable&) = delete;
+    DiskTable& operator=(const DiskTable&) = delete;
+
+    ~DiskTable(void)
+    {
+        if (m_mapping) munmap(m_mapping, m_mapping_size);
+        if (m_fd >= 0) close(m_fd);
+    }
+
+    bool is_open(void) const { return m_mapping != nullptr; }
+
+    std::optional<std::vector<IntType>> lookup(const ProgramKey& program,
+                                               const std::vector<IntType>& inputs) const
+    {
+        if (!is_open()) return {};
+
+        const Slot* slot = find_slot(program, hash_values(inputs), inputs);
+        if (!slot || !is_occupied(slot)) return {};
+
+        const IntType* outputs = m_data + slot->data_offset + slot->input_count;
+        return std::vector<IntType>(outputs, outputs + slot->output_count);
+    }
+
+    bool store(const ProgramKey& program, const std::vector<IntType>& inputs,
+               const std::vector<IntType>& outputs)
+    {
+        if (!is_open()) return false;
+
+        // other processes may be storing at the same time; data_used and the slot we claim
+        // must be read and updated as one step
+        WriteLock lock(m_fd);
+
+        const uint64_t data_used = m_header->data_used;
+        const uint64_t cells = inputs.size() + outputs.size();
+        if (data_used > m_header->data_capacity || cells > m_header->data_capacity - data_used) {
+            return false;
+        }
+
+        const uint64_t input_hash = hash_values(inputs);
+        Slot* slot = find_slot(program, input_hash, inputs);
+        if (!slot || is_occupied(slot)) return false;
+
+        std::copy(inputs.begin(), inputs.end(), m_data + data_used);
+        std::copy(outputs.begin(), outputs.end(), m_data + data_used + inputs.size());
+        slot->program_hash = program.hash;
+        slot->program_length = program.length;
+        slot->input_hash = input_hash;
+        slot->data_offset = data_used;
+        slot->input_count = inputs.size();
+        slot->output_count = outputs.size();
+        m_header->data_used = data_used + cells;
+
+        // publish the slot only once the data and the fields above are in place
+        __atomic_store_n(&slot->occupied, uint64_t(1), __ATOMIC_RELEASE);
+
+        return true;
+    }
+};
+
+}  // namespace intcode_cache_detail
+
+class IntCodeResultCache {
+public:
+    using ProgramKey = intcode_cache_detail::ProgramKey;
+
+private:
+    using CacheKey = intcode_cache_detail::CacheKey;
+    using CacheEntry = std::pair<CacheKey, std::vector<IntType>>;
+
+    // most recently used entries at the front
+    std::list<CacheEntry> m_lru;
+    std::unordered_map<CacheKey, std::list<CacheEntry>::iterator, intcode_cache_detail::CacheKeyHash>
+        m_index;
+    size_t m_capacity;
+
+    std::optional<intcode_cache_detail::DiskTable> m_disk;
+
+    void insert_in_memory(CacheKey key, std::vector<IntType> outputs)
+    {
+        // storing a key again replaces its entry; a second node would leave the index
+        // pointing at whichever was inserted last, and evicting the other would erase it
+        auto it = m_index.find(key);
+        if (it != m_index.end()) {
+            it->second->second = std::move(outputs);
+            m_lru.splice(m_lru.begin(), m_lru, it->second);
+            return;
+        }
+
+        m_lru.emplace_front(std::move(key), std::move(outputs));
+        m_index[m_lru.front().first] = m_lru.begin();
+
+        if (m_lru.size() > m_capacity) {
+            m_index.erase(m_lru.back().first);
+            m_lru.pop_back();
+        }
+    }
+
+public:
+    // 'disk_path' may be null for a purely in-memory cache
+    IntCodeResultCache(size_t capacity, const char* disk_path = nullptr,
+                       uint64_t disk_slot_count = 1 << 16, uint64_t disk_data_capacity = 1 << 22)
+        : m_capacity(capacity)
+    {
+        assert(capacity > 0);
+        if (disk_path) m_disk.emplace(disk_path, disk_slot_count, disk_data_capacity);
+    }
+
+    static ProgramKey hash_program(const std::vector<IntType>& program)
+    {
+        return {intcode_cache_detail::hash_values(program), program.size()};
+    }
+
+    std::optional<std::vector<IntType>> lookup(const ProgramKey& program, const std::vector<IntType>& inputs)
+    {
+        CacheKey key{program, inputs};
+
+        auto it = m_index.find(key);
+        if (it != m_index.end()) {
+            m_lru.splice(m_lru.begin(), m_lru, it->second);
+            return it->second->second;
+        }
+
+        if (m_disk) {
+            auto outputs = m_disk->lookup(program, inputs);
+            if (outputs) {
+                insert_in_memory(std::move(key), *outputs);
+                return outputs;
+            }
+        }
+
+        return {};
+    }
+
+    void store(const ProgramKey& program, const std::vector<IntType>& inputs,
+               const std::vector<IntType>& outputs)
+    {
+        if (m_disk) m_disk->store(program, inputs, outputs);
+        insert_in_memory({program, inputs}, outputs);
+    }
+
+    // Equivalent to IntCodeVM(program).run_until_halt_with_inputs(inputs), but only runs the
+    // VM the first time a given (program, inputs) pair is seen.
+    std::vector<IntType> run(const std::vector<IntType>& program, const std::vector<IntType>& inputs)
+    {
+        return run(program, hash_program(program), inputs);
+    }
+
+    // as above, for callers that run the same program many times and hash it once up front
+    std::vector<IntType> run(const std::vector<IntType>& program, const ProgramKey& program_key,
+                             const std::vector<IntType>& inputs)
+    {
+        if (auto outputs = lookup(program_key, inputs)) return *outputs;
+
+        IntCodeVM vm(program);
+        std::vector<IntType> outputs = vm.run_until_halt_with_inputs(inputs);
+        store(program_key, inputs, outputs);
+        return outputs;
+    }
+};
@@ -0,0 +1,38 @@
+#include <chrono>
+#include <cstring>
+#include <iostream>
+
+#include "intcode_analysis.hpp"
+
+// usage: intcode_disasm <program file> [--dot]
+int main(int argc, char** argv)
+{
+    std::ios_base::sync_with_stdio(false);
+
+    if (argc < 2) {
+        std::cerr << "usage: " << argv[0] << " <program file> [--dot]" << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    const bool graphviz = argc > 2 && std::strcmp(argv[2], "--dot") == 0;
+
+    const auto program = read_program_from_file(argv[1]);
+
+    const auto start_time = std::chrono::steady_clock::now();
+    const auto cfg = intcode_analysis::build_cfg(program);
+    const auto end_time = std::chrono::steady_clock::now();
+
+    if (graphviz) {
+        intcode_analysis::print_cfg_graphviz(std::cout, cfg);
+    }
+    else {
+        intcode_analysis::print_cfg_text(std::cout, cfg);
+    }
+
+    std::cerr << program.size() << " cells, " << cfg.instructions.size() << " instructions, "
+              << cfg.blocks.size() << " blocks, analyzed in "
+              << std::chrono::duration_cast<std::chrono::microseconds>(end_time - start_time).count()
+              << "us" << std::endl;
+
+    return 0;
+}
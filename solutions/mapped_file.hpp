@@ -0,0 +1,49 @@
+#pragma once
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstdlib>
+#include <iostream>
+#include <string_view>
+
+// Read-only mapping of a whole file, unmapped on destruction
+class MappedFile {
+    void* m_mapping;
+    size_t m_size;
+
+public:
+    MappedFile(const char* filepath) : m_mapping(nullptr), m_size(0)
+    {
+        const int fd = open(filepath, O_RDONLY);
+        if (fd < 0) {
+            std::cerr << "Failed to open " << filepath << std::endl;
+            exit(EXIT_FAILURE);
+        }
+
+        struct stat st;
+        fstat(fd, &st);
+        m_size = st.st_size;
+        if (m_size > 0) {
+            m_mapping = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (m_mapping == MAP_FAILED) {
+                std::cerr << "Failed to map " << filepath << std::endl;
+                exit(EXIT_FAILURE);
+            }
+            madvise(m_mapping, m_size, MADV_SEQUENTIAL);
+        }
+        close(fd);
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    ~MappedFile(void)
+    {
+        if (m_mapping) munmap(m_mapping, m_size);
+    }
+
+    std::string_view contents(void) const { return {static_cast<const char*>(m_mapping), m_size}; }
+};
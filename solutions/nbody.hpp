@@ -0,0 +1,235 @@
+#pragma once
+
+#include <assert.h>
+
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// The day 12 moons generalised to any number of bodies. The axes of the simulation never
+// interact, so the system is stored as struct of arrays: one NBodyAxis per dimension, each
+// holding every body's position and velocity on that axis in contiguous vectors.
+
+namespace nbody_detail {
+
+static void parse_error(const char* filepath, size_t line_number, const std::string& line)
+{
+    std::cerr << filepath << ":" << line_number << ": expected <x=.., y=.., z=..>, got \"" << line
+              << "\"" << std::endl;
+    exit(EXIT_FAILURE);
+}
+
+// parses "<x=3, y=15, z=8>", tolerating spaces around the separators
+static bool parse_body(std::string_view line, std::array<int64_t, 3>& coordinates)
+{
+    constexpr char AXIS_NAMES[3] = {'x', 'y', 'z'};
+
+    auto skip_spaces = [&](void) {
+        while (!line.empty() && (line.front() == ' ' || line.front() == '\t')) line.remove_prefix(1);
+    };
+    auto expect = [&](char c) {
+        skip_spaces();
+        if (line.empty() || line.front() != c) return false;
+        line.remove_prefix(1);
+        return true;
+    };
+
+    if (!expect('<')) return false;
+    for (size_t axis = 0; axis < 3; axis++) {
+        if (axis > 0 && !expect(',')) return false;
+        if (!expect(AXIS_NAMES[axis]) || !expect('=')) return false;
+        skip_spaces();
+
+        const auto [end, error] = std::from_chars(line.data(), line.data() + line.size(), coordinates[axis]);
+        if (error != std::errc()) return false;
+        line.remove_prefix(end - line.data());
+    }
+    if (!expect('>')) return false;
+
+    skip_spaces();
+    return line.empty() || line == "\r";
+}
+
+}  // namespace nbody_detail
+
+struct NBodyAxis {
+    // Below this many bodies the pairwise loop is about as fast as sorting once the compiler
+    // vectorises it (12_1 --gravity-bench); above it, rank counting wins by a growing margin.
+    static constexpr size_t RANKED_GRAVITY_THRESHOLD = 32;
+
+    std::vector<int64_t> pos;
+    std::vector<int64_t> vel;
+
+    // indices of the bodies in increasing order of position, kept between steps for
+    // apply_gravity_ranked(); rebuilt from scratch whenever the body count changes
+    std::vector<uint32_t> order;
+
+    size_t body_count(void) const { return pos.size(); }
+
+    void apply_gravity(void)
+    {
+        if (pos.size() < RANKED_GRAVITY_THRESHOLD) {
+            apply_gravity_pairwise();
+        }
+        else {
+            apply_gravity_ranked();
+        }
+    }
+
+    // Every body is pulled one unit towards every other body. Written without branches so
+    // that the inner loop vectorises: comparisons come out as 0 or 1 and are summed.
+    void apply_gravity_pairwise(void)
+    {
+        const size_t n = pos.size();
+        const int64_t* p = pos.data();
+
+        for (size_t i = 0; i < n; i++) {
+            const int64_t own = p[i];
+            int64_t pull = 0;
+            for (size_t j = 0; j < n; j++) pull += (p[j] > own) - (p[j] < own);
+            vel[i] += pull;
+        }
+    }
+
+    // The pull on a body is (bodies above it) - (bodies below it), so with the bodies in
+    // sorted order a run of equal positions at ranks [lo, hi) all get n - hi - lo. O(N log N)
+    // for the sort, and usually much less since the order is carried over between steps.
+    void apply_gravity_ranked(void)
+    {
+        sort_order();
+
+        const size_t n = pos.size();
+        for (size_t lo = 0; lo < n;) {
+            const int64_t position = pos[order[lo]];
+            size_t hi = lo + 1;
+            while (hi < n && pos[order[hi]] == position) hi++;
+
+            const int64_t pull = int64_t(n - hi) - int64_t(lo);
+            for (size_t k = lo; k < hi; k++) vel[order[k]] += pull;
+            lo = hi;
+        }
+    }
+
+    // Bodies only move a little each step, so last step's order is nearly sorted and an
+    // insertion sort fixes it up in close to linear time. If the bodies have moved past each
+    // other too much for that, fall back to a full sort.
+    void sort_order(void)
+    {
+        const size_t n = pos.size();
+        auto by_position = [this](uint32_t a, uint32_t b) { return pos[a] < pos[b]; };
+
+        if (order.size() != n) {
+            order.resize(n);
+            for (size_t i = 0; i < n; i++) order[i] = i;
+            std::sort(order.begin(), order.end(), by_position);
+            return;
+        }
+
+        const size_t max_shifts = 4 * n;
+        size_t shifts = 0;
+        for (size_t i = 1; i < n; i++) {
+            const uint32_t body = order[i];
+            const int64_t position = pos[body];
+
+            size_t j = i;
+            while (j > 0 && pos[order[j - 1]] > position) {
+                order[j] = order[j - 1];
+                j--;
+                shifts++;
+            }
+            order[j] = body;
+
+            if (shifts > max_shifts) {
+                std::sort(order.begin(), order.end(), by_position);
+                return;
+            }
+        }
+    }
+
+    void apply_velocity(void)
+    {
+        for (size_t i = 0; i < pos.size(); i++) pos[i] += vel[i];
+    }
+
+    void step(void)
+    {
+        apply_gravity();
+        apply_velocity();
+    }
+
+    friend bool operator==(const NBodyAxis& a, const NBodyAxis& b)
+    {
+        return a.pos == b.pos && a.vel == b.vel;
+    }
+    friend bool operator!=(const NBodyAxis& a, const NBodyAxis& b) { return !(a == b); }
+};
+
+struct NBodySystem {
+    std::array<NBodyAxis, 3> axes;
+
+    size_t body_count(void) const { return axes[0].body_count(); }
+
+    void add_body(const std::array<int64_t, 3>& position)
+    {
+        for (size_t axis = 0; axis < 3; axis++) {
+            axes[axis].pos.push_back(position[axis]);
+            axes[axis].vel.push_back(0);
+        }
+    }
+
+    void step(size_t steps = 1)
+    {
+        for (auto& axis : axes) {
+            for (size_t i = 0; i < steps; i++) axis.step();
+        }
+    }
+
+    // sum over bodies of (potential energy) * (kinetic energy), where each is the sum of
+    // absolute values over the axes
+    int64_t total_energy(void) const
+    {
+        int64_t total = 0;
+        for (size_t body = 0; body < body_count(); body++) {
+            int64_t potential = 0;
+            int64_t kinetic = 0;
+            for (const auto& axis : axes) {
+                potential += std::abs(axis.pos[body]);
+                kinetic += std::abs(axis.vel[body]);
+            }
+            total += potential * kinetic;
+        }
+        return total;
+    }
+};
+
+// one "<x=.., y=.., z=..>" body per line, all starting at rest; blank lines are skipped
+static NBodySystem read_bodies(const char* filepath)
+{
+    std::ifstream infile(filepath);
+    if (!infile) {
+        std::cerr << "Unable to open " << filepath << std::endl;
+        exit(EXIT_FAILURE);
+    }
+
+    NBodySystem system;
+    std::string line;
+    size_t line_number = 0;
+    while (std::getline(infile, line)) {
+        line_number++;
+        if (line.find_first_not_of(" \t\r") == std::string::npos) continue;
+
+        std::array<int64_t, 3> position;
+        if (!nbody_detail::parse_body(line, position)) {
+            nbody_detail::parse_error(filepath, line_number, line);
+        }
+        system.add_body(position);
+    }
+
+    return system;
+}
@@ -4,7 +4,10 @@
 #include <fstream>
 #include <functional>
 #include <iostream>
+#include <optional>
 #include <string>
+#include <string_view>
+#include <vector>
 
 #include "flat_hash_map/flat_hash_map.hpp"
 